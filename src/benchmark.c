@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib1617.h"
+
+// thread per le prove concorrenti, con le API di Windows o con quelle POSIX
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+typedef HANDLE Thread;
+#define THREAD_FUNC DWORD WINAPI
+#define threadStart(t, f, arg) (((t) = CreateThread(NULL, 0, f, arg, 0, NULL)) != NULL)
+#define threadJoin(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+#include <pthread.h>
+#include <sys/resource.h>
+typedef pthread_t Thread;
+#define THREAD_FUNC void*
+#define threadStart(t, f, arg) (pthread_create(&(t), NULL, f, arg) == 0)
+#define threadJoin(t) pthread_join(t, NULL)
+#endif
+
+#define WORDS 200000    // parole inserite nel dizionario
+#define QUERIES 2000000 // ricerche eseguite per ogni prova
+#define SPELLS 200      // ricerche avanzate eseguite per ogni prova
+#define UPDATES 20000   // modifiche registrate nel log
+#define GROUP_COMMIT 64 // record dopo i quali il log viene reso persistente
+#define MIX_OPS 500000  // operazioni eseguite da ogni thread nelle prove concorrenti
+#define MAX_THREADS 8   // thread usati dall'ultima prova concorrente (raddoppiati a partire da 1)
+#define INGEST 100000   // parole inserite da ogni thread nel dizionario diviso in parti
+#define SHARDS 16       // parti del dizionario diviso
+#define REPEATS 3000000 // parole del file fatto di due sole parole ripetute
+#define REPEAT_SLACK 4  // MB di memoria che createFromFile può occupare oltre al file mappato con le ripetizioni
+
+#define LENGTH 12       // lunghezza massima delle parole generate
+
+// conta le parole visitate da prefixScan
+static void countScanned(char *word, char *def, void *count)
+{
+    (void) word;
+    (void) def;
+    (*(int *) count)++;
+}
+
+// genera una parola casuale di lunghezza compresa fra MIN_WORD e LENGTH
+static void randomWord(char *w)
+{
+    int i, len;
+
+    len = MIN_WORD + rand() % (LENGTH - MIN_WORD + 1);
+    for(i = 0; i < len; i++)
+        w[i] = 'a' + rand() % 26;
+    w[i] = '\0';
+}
+
+// ritorna il massimo di memoria fisica occupata finora dal processo, in MB
+static double peakMemory(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS m;
+
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &m, sizeof(m))) return 0;
+    return m.PeakWorkingSetSize / 1048576.0;
+#else
+    struct rusage u;
+
+    if(getrusage(RUSAGE_SELF, &u) != 0) return 0;
+#ifdef __APPLE__
+    return u.ru_maxrss / 1048576.0;  // in byte
+#else
+    return u.ru_maxrss / 1024.0;     // in KB
+#endif
+#endif
+}
+
+// ritorna i secondi trascorsi dall'istante start
+static double elapsed(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+// ritorna i secondi del tempo reale, che per le prove concorrenti non coincide con quello di calcolo sommato da clock
+static double wallTime(void)
+{
+    struct timespec t;
+
+    timespec_get(&t, TIME_UTC);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// lavoro di un thread nelle prove concorrenti: MIX_OPS ricerche di parole prese da queries, una ogni writes
+// sostituita da una modifica della definizione (writes = 0 per le sole ricerche)
+typedef struct
+{
+    SHARED *shared;
+    char **queries;
+    int writes;
+    unsigned int seed;  // stato del generatore del thread (rand non può essere usata da più thread)
+    int found;
+} MixArgs;
+
+static THREAD_FUNC mixWorker(void *arg)
+{
+    MixArgs *a;
+    char *def;
+    int i;
+
+    a = (MixArgs *) arg;
+    a->found = 0;
+    for(i = 0; i < MIX_OPS; i++)
+    {
+        a->seed = a->seed * 1103515245u + 12345u;
+        if(a->writes > 0 && i % a->writes == 0)
+            sharedInsertDef(a->shared, a->queries[(a->seed >> 8) % QUERIES], "definizione");
+        else
+        {
+            def = sharedSearchDef(a->shared, a->queries[(a->seed >> 8) % QUERIES]);
+            a->found += (def != NULL);
+            free(def);
+        }
+    }
+    return 0;
+}
+
+// inserimento di INGEST parole casuali nel dizionario diviso in parti
+typedef struct
+{
+    SHARDED *sharded;
+    unsigned int seed;
+} IngestArgs;
+
+static THREAD_FUNC ingestWorker(void *arg)
+{
+    IngestArgs *a;
+    char w[LENGTH + 1];
+    int i, j, len;
+
+    a = (IngestArgs *) arg;
+    for(i = 0; i < INGEST; i++)
+    {
+        a->seed = a->seed * 1103515245u + 12345u;
+        len = MIN_WORD + (a->seed >> 8) % (LENGTH - MIN_WORD + 1);
+        for(j = 0; j < len; j++)
+        {
+            a->seed = a->seed * 1103515245u + 12345u;
+            w[j] = 'a' + (a->seed >> 8) % 26;
+        }
+        w[j] = '\0';
+        shardedInsertWord(a->sharded, w);
+    }
+    return 0;
+}
+
+// inserisce in parallelo le parole con 1, 2, 4, ... MAX_THREADS thread, ogni volta in un nuovo dizionario diviso
+// creato dal file delle parole, e stampa gli inserimenti al secondo
+static int ingestBenchmark(char *fileWords)
+{
+    Thread threads[MAX_THREADS];
+    IngestArgs args[MAX_THREADS];
+    SHARDED *sharded;
+    NODO *dictionary;
+    double start;
+    int i, t;
+
+    for(t = 1; t <= MAX_THREADS; t *= 2)
+    {
+        dictionary = createFromFile(fileWords);
+        if(dictionary == NULL) return 1;
+        sharded = shardDictionary(dictionary, SHARDS);
+        if(sharded == NULL) return 1;
+
+        start = wallTime();
+        for(i = 0; i < t; i++)
+        {
+            args[i].sharded = sharded;
+            args[i].seed = 1617 + i;
+            if(!threadStart(threads[i], ingestWorker, &args[i])) return 1;
+        }
+        for(i = 0; i < t; i++)
+            threadJoin(threads[i]);
+        printf("  %d thread                   : %8.2f Mop/s (%d parole)\n", t,
+               (double) t * INGEST / (wallTime() - start) / 1e6, shardedCountWord(sharded));
+        destroySharded(sharded);
+    }
+    return 0;
+}
+
+// esegue la prova concorrente con 1, 2, 4, ... MAX_THREADS thread e stampa le operazioni al secondo
+static int mixBenchmark(SHARED *shared, char **queries, int writes)
+{
+    Thread threads[MAX_THREADS];
+    MixArgs args[MAX_THREADS];
+    double start;
+    int i, t;
+
+    for(t = 1; t <= MAX_THREADS; t *= 2)
+    {
+        start = wallTime();
+        for(i = 0; i < t; i++)
+        {
+            args[i].shared = shared;
+            args[i].queries = queries;
+            args[i].writes = writes;
+            args[i].seed = 1617 + i;
+            if(!threadStart(threads[i], mixWorker, &args[i])) return 1;
+        }
+        for(i = 0; i < t; i++)
+            threadJoin(threads[i]);
+        printf("  %d thread                   : %8.2f Mop/s\n", t, (double) t * MIX_OPS / (wallTime() - start) / 1e6);
+    }
+    return 0;
+}
+
+// crea il dizionario da un file di REPEATS parole, tutte uguali a una di due: le ripetizioni non devono occupare
+// memoria, quindi oltre al file (che viene mappato) createFromFile può usarne al più REPEAT_SLACK MB
+static int repeatBenchmark(void)
+{
+    NODO *dictionary;
+    FILE *f;
+    clock_t start;
+    double before, size;
+    int i;
+
+    fopen_s(&f, "benchmark_repeats.txt", "w");
+    if(f == NULL) return 1;
+    for(i = 0; i < REPEATS; i++)
+        fputs((i % 2 == 0) ? "ab\n" : "cd\n", f);
+    size = ftell(f) / 1048576.0;
+    fclose(f);
+
+    before = peakMemory();
+    start = clock();
+    dictionary = createFromFile("benchmark_repeats.txt");
+    if(dictionary == NULL) return 1;
+    printf("createFromFile (%d ripetute): %8.1f ms, %.1f MB occupati con un file di %.1f MB\n", REPEATS,
+           elapsed(start) * 1e3, peakMemory() - before, size);
+    i = (countWord(dictionary) != 2 || peakMemory() - before > size + REPEAT_SLACK);
+    destroyDictionary(dictionary);
+    remove("benchmark_repeats.txt");
+    if(i)
+        printf("errore: le parole ripetute occupano memoria\n");
+    return i;
+}
+
+int main(void)
+{
+    NODO *dictionary, *durable;
+    SHARED *shared;
+    VERSIONED *versioned;
+    VERSION *version;
+    FROZEN *frozen, *mapped;
+    AdvanceResult *advanced;
+    char w[MAX_WORD + 1], (*missing)[MAX_WORD + 1], **queries, *r[3];
+    int i, j, n, found;
+    int *positions;
+    clock_t start;
+    FILE *f;
+    CURSOR cursor;
+
+    // la prova delle ripetizioni va fatta per prima, quando il massimo di memoria occupata è ancora basso
+    if(repeatBenchmark() != 0) return 1;
+
+    srand(1617);
+    queries = (char **) malloc(QUERIES * sizeof(char *));
+    missing = malloc(QUERIES / 2 * sizeof(*missing));
+    positions = (int *) malloc(QUERIES * sizeof(int));
+    advanced = (AdvanceResult *) malloc(SPELLS * sizeof(AdvanceResult));
+    if(queries == NULL || missing == NULL || positions == NULL || advanced == NULL) return 1;
+
+    // scrivo le parole casuali su un file temporaneo da cui creo il dizionario
+    fopen_s(&f, "benchmark_words.txt", "w");
+    if(f == NULL) return 1;
+    for(i = 0; i < WORDS; i++)
+    {
+        randomWord(w);
+        fprintf(f, "%s\n", w);
+    }
+    fclose(f);
+    dictionary = createFromFile("benchmark_words.txt");
+    if(dictionary == NULL) return 1;
+    n = countWord(dictionary);
+
+    // metà delle ricerche riguarda parole presenti, l'altra metà parole (quasi certamente) assenti
+    for(i = 0; i < QUERIES; i++)
+    {
+        positions[i] = rand() % n;
+        if(i % 2 == 0)
+            queries[i] = getWordAt(dictionary, positions[i]);
+        else
+        {
+            randomWord(missing[i / 2]);
+            queries[i] = missing[i / 2];
+        }
+    }
+    printf("dizionario con %d parole, %d ricerche per prova\n\n", n, QUERIES);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += (searchDef(dictionary, queries[i]) != NULL);
+    printf("searchDef (RBT)              : %8.1f ns/ricerca (%d trovate)\n", elapsed(start) * 1e9 / QUERIES, found);
+
+    start = clock();
+    frozen = freezeDictionary(dictionary);
+    if(frozen == NULL) return 1;
+    printf("freezeDictionary             : %8.1f ms\n", elapsed(start) * 1e3);
+
+    if(snapshotDictionary(dictionary, "benchmark_snapshot.bin") != 0) return 1;
+    start = clock();
+    mapped = mapDictionary("benchmark_snapshot.bin");
+    if(mapped == NULL) return 1;
+    printf("mapDictionary                : %8.1f ms\n", elapsed(start) * 1e3);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += (frozenSearchDef(frozen, queries[i]) != NULL);
+    printf("frozenSearchDef (Eytzinger)  : %8.1f ns/ricerca (%d trovate)\n", elapsed(start) * 1e9 / QUERIES, found);
+
+    if(enableHashIndex(dictionary) != 0) return 1;
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += (searchDef(dictionary, queries[i]) != NULL);
+    printf("searchDef (indice hash)      : %8.1f ns/ricerca (%d trovate)\n", elapsed(start) * 1e9 / QUERIES, found);
+    disableHashIndex(dictionary);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += getWordAt(dictionary, positions[i])[0];
+    printf("getWordAt (RBT)              : %8.1f ns/ricerca\n", elapsed(start) * 1e9 / QUERIES);
+
+    start = clock();
+    for(i = 0; i < QUERIES; i++)
+        found += frozenGetWordAt(frozen, positions[i])[0];
+    printf("frozenGetWordAt              : %8.1f ns/ricerca\n", elapsed(start) * 1e9 / QUERIES);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += (rankOf(dictionary, queries[i]) == positions[i]);
+    printf("rankOf                       : %8.1f ns/ricerca (%d esatte)\n", elapsed(start) * 1e9 / QUERIES, found);
+
+    // scansione dei prefissi formati dalle prime due lettere delle parole cercate
+    start = clock();
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+    {
+        w[0] = queries[i][0];
+        w[1] = queries[i][1];
+        w[2] = '\0';
+        prefixScan(dictionary, w, countScanned, &found, -1);
+    }
+    printf("prefixScan (2 lettere)       : %8.1f us/scansione (%d parole)\n", elapsed(start) * 1e6 / SPELLS, found);
+
+    // pagine di 100 parole lette con un cursore a partire da posizioni casuali
+    start = clock();
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+        for(j = 0, cursorSeekAt(&cursor, dictionary, positions[i]); j < 100 && cursorWord(&cursor) != NULL; j++)
+        {
+            found += cursorWord(&cursor)[0];
+            cursorNext(&cursor);
+        }
+    printf("cursorSeekAt + 100 cursorNext: %8.1f us/pagina\n", elapsed(start) * 1e6 / SPELLS);
+
+    start = clock();
+    if(saveDictionary(dictionary, "benchmark_saved.txt") != 0) return 1;
+    printf("saveDictionary               : %8.1f ms\n", elapsed(start) * 1e3);
+    remove("benchmark_saved.txt");
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+    {
+        found += searchAdvance(dictionary, queries[i], &r[0], &r[1], &r[2]);
+        for(j = 0; j < 3; j++)
+            free(r[j]);
+    }
+    printf("searchAdvance                : %8.1f us/ricerca (%d trovate)\n", elapsed(start) * 1e6 / SPELLS, found);
+
+    if(enableSpellIndex(dictionary) != 0) return 1;
+    start = clock();
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+    {
+        found += searchAdvance(dictionary, queries[i], &r[0], &r[1], &r[2]);
+        for(j = 0; j < 3; j++)
+            free(r[j]);
+    }
+    printf("searchAdvance (BK-tree)      : %8.1f us/ricerca (%d trovate)\n", elapsed(start) * 1e6 / SPELLS, found);
+    disableSpellIndex(dictionary);
+
+    start = clock();
+    if(searchAdvanceBatch(dictionary, queries, SPELLS, advanced) != 0) return 1;
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+        found += advanced[i].found;
+    printf("searchAdvanceBatch           : %8.1f us/ricerca (%d trovate)\n", elapsed(start) * 1e6 / SPELLS, found);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < SPELLS; i++)
+    {
+        found += frozenSearchAdvance(mapped, queries[i], &r[0], &r[1], &r[2]);
+        for(j = 0; j < 3; j++)
+            free(r[j]);
+    }
+    printf("frozenSearchAdvance (mappato): %8.1f us/ricerca (%d trovate)\n", elapsed(start) * 1e6 / SPELLS, found);
+
+    // dizionario persistente che parte dall'istantanea e registra le modifiche nel log
+    start = clock();
+    durable = openDictionary("benchmark_snapshot.bin", "benchmark_log.bin", GROUP_COMMIT);
+    if(durable == NULL) return 1;
+    printf("openDictionary               : %8.1f ms\n", elapsed(start) * 1e3);
+
+    start = clock();
+    for(i = 0; i < UPDATES; i++)
+    {
+        randomWord(w);
+        insertWord(&durable, w);
+        insertDef(durable, w, "definizione");
+    }
+    if(commitDictionary(durable) != 0) return 1;
+    printf("insertWord + insertDef (log) : %8.1f us/modifica\n", elapsed(start) * 1e6 / UPDATES);
+
+    start = clock();
+    if(compactDictionary(durable) != 0) return 1;
+    if(destroyDictionary(durable) != 0) return 1;  // attende la fine della compattazione
+    printf("compactDictionary            : %8.1f ms\n", elapsed(start) * 1e3);
+
+    destroyFrozen(frozen);
+    destroyFrozen(mapped);
+    remove("benchmark_snapshot.bin");
+    remove("benchmark_log.bin");
+
+    // dizionario persistente: una versione acquisita resta invariata mentre le modifiche continuano
+    start = clock();
+    versioned = versionDictionary(dictionary);
+    if(versioned == NULL) return 1;
+    printf("versionDictionary            : %8.1f ms\n", elapsed(start) * 1e3);
+
+    version = acquireVersion(versioned);
+    start = clock();
+    for(i = 0; i < UPDATES; i++)
+    {
+        randomWord(w);
+        versionedInsertWord(versioned, w);
+        versionedInsertDef(versioned, w, "definizione");
+    }
+    printf("versionedInsertWord + Def    : %8.1f us/modifica\n", elapsed(start) * 1e6 / UPDATES);
+
+    start = clock();
+    found = 0;
+    for(i = 0; i < QUERIES; i++)
+        found += (versionSearchDef(version, queries[i]) != NULL);
+    printf("versionSearchDef             : %8.1f ns/ricerca (%d trovate)\n", elapsed(start) * 1e9 / QUERIES, found);
+    releaseVersion(version);
+    destroyVersioned(versioned);
+
+    // il dizionario condiviso fra più thread, con sole ricerche e con una modifica ogni 100 operazioni
+    shared = shareDictionary(dictionary);
+    if(shared == NULL) return 1;
+    printf("sharedSearchDef (concorrente):\n");
+    if(mixBenchmark(shared, queries, 0) != 0) return 1;
+    printf("sharedSearchDef + 1%% sharedInsertDef:\n");
+    if(mixBenchmark(shared, queries, 100) != 0) return 1;
+
+    destroyShared(shared);
+
+    // inserimenti paralleli nelle parti del dizionario, che partono dalle stesse parole
+    printf("shardedInsertWord (%d parti):\n", SHARDS);
+    if(ingestBenchmark("benchmark_words.txt") != 0) return 1;
+    remove("benchmark_words.txt");
+    free(queries);
+    free(missing);
+    free(positions);
+    free(advanced);
+    return 0;
+}
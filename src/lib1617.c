@@ -2,43 +2,242 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include "lib1617.h"
 
 // MACRO
 #define minimum(a,b) ((a<b) ? a : b)    // minore fra due valori
 #define isLeftChild(n) (n->father->children[LEFT] == n) // ritorna 1 se un nodo è figlio sinistro
 
+// richiede in anticipo alla cache la linea contenente l'indirizzo p (disattivabile definendo NO_PREFETCH)
+#if defined(NO_PREFETCH)
+#define prefetch(p)
+#elif defined(__GNUC__)
+#define prefetch(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define prefetch(p) _mm_prefetch((const char *) (p), _MM_HINT_T0)
+#else
+#define prefetch(p)
+#endif
+
+// thread, operazioni atomiche e file mappati in memoria, con le API di Windows o con quelle POSIX
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+typedef HANDLE Thread;
+typedef LPTHREAD_START_ROUTINE ThreadFunc;
+#define THREAD_FUNC DWORD WINAPI
+#define threadStart(t, f, arg) (((t) = CreateThread(NULL, 0, f, arg, 0, NULL)) != NULL)
+#define threadJoin(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#define atomicIncrement(p) (InterlockedIncrement((volatile LONG *) (p)) - 1)   // ritorna il valore precedente
+#define atomicDecrement(p) (InterlockedDecrement((volatile LONG *) (p)) + 1)   // ritorna il valore precedente
+#define atomicRead(p) InterlockedCompareExchange((volatile LONG *) (p), 0, 0)
+#define atomicCompareSwap(p, old, new) (InterlockedCompareExchange((volatile LONG *) (p), new, old) == (old))
+#define threadYield() SwitchToThread()
+#include <io.h>
+#define syncFile(f) (fflush(f) != 0 || _commit(_fileno(f)) != 0)   // diverso da 0 in caso di errori
+#define replaceFile(from, to) (MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0)
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef pthread_t Thread;
+typedef void* (*ThreadFunc)(void *);
+#define THREAD_FUNC void*
+#define threadStart(t, f, arg) (pthread_create(&(t), NULL, f, arg) == 0)
+#define threadJoin(t) pthread_join(t, NULL)
+#define atomicIncrement(p) __sync_fetch_and_add(p, 1)   // ritorna il valore precedente
+#define atomicDecrement(p) __sync_fetch_and_sub(p, 1)   // ritorna il valore precedente
+#define atomicRead(p) __sync_fetch_and_add(p, 0)
+#define atomicCompareSwap(p, old, new) __sync_bool_compare_and_swap(p, old, new)
+#define threadYield() sched_yield()
+#define syncFile(f) (fflush(f) != 0 || fsync(fileno(f)) != 0)   // diverso da 0 in caso di errori
+#define replaceFile(from, to) (rename(from, to) != 0)
+#endif
+
 /// FUNZIONI STATICHE PER RICERCA AVANZATA
 
-// calcolo della distanza di Damerau-Levenshtein fra due stringhe
-static int DL_distance(char s1[], char s2[])
+// parola cercata dalla ricerca avanzata, preparata per il calcolo bit-parallelo della distanza di Damerau-Levenshtein
+typedef struct
+{
+    unsigned int peq[256];  // peq[c] ha a 1 i bit delle posizioni della parola in cui compare il carattere c
+    unsigned int last;      // bit della posizione dell'ultimo carattere
+    int len;
+} DLPattern;
+
+// prepara la parola w (lunga al più MAX_WORD caratteri, quindi ogni colonna della matrice sta in un intero)
+static void DL_prepare(DLPattern *p, char *w)
+{
+    int i;
+
+    memset(p->peq, 0, sizeof(p->peq));
+    for(i=0; w[i] != '\0'; i++)
+        p->peq[(unsigned char) w[i]] |= 1u << i;
+    p->len = i;
+    p->last = (i > 0) ? 1u << (i - 1) : 0;
+}
+
+// calcolo della distanza di Damerau-Levenshtein fra la parola preparata e s (algoritmo bit-parallelo di Myers esteso
+// agli scambi da Hyyrö): invece di riempire la matrice colonna per colonna, tengo come bit le differenze fra celle
+// adiacenti della colonna corrente (VP = +1, VN = -1) e ne aggiorno tutte le righe insieme con poche operazioni
+// la distanza è esatta solo se non supera cutoff, altrimenti il calcolo si interrompe e ritorna un valore maggiore
+static int DL_distance(DLPattern *p, char *s, int cutoff)
 {
-    int i, j, current_cost, matrix[MAX_WORD + 1][MAX_WORD + 1];
+    unsigned int pm, oldPm, vp, vn, d0, hp, hn, tr;
+    int score, remaining;
 
-    for(j=0; s2[j] != '\0'; j++)
-        matrix[0][j] = j;
-    matrix[0][j] = j; // devo riempire anche la casella al posto len(s2)
+    remaining = strlen(s);
+    if(p->len == 0) return remaining;
 
-    // al termine, i = len(s1) e j = len(s2)
-    for(i=0; s1[i] != '\0'; i++)
+    // la distanza non può essere minore della differenza fra le lunghezze
+    if(abs(remaining - p->len) > cutoff) return cutoff + 1;
+
+    vp = ~0u;
+    vn = 0;
+    d0 = 0;
+    oldPm = 0;
+    score = p->len;  // ultima cella della colonna corrente
+    for(; *s != '\0'; s++)
     {
-        matrix[i+1][0] = i+1;
+        pm = p->peq[(unsigned char) *s];
+
+        // d0 = celle diagonali che non aumentano: per corrispondenza, per un vicino che diminuisce o per uno scambio
+        tr = (((~d0) & pm) << 1) & oldPm;
+        d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+
+        // differenze orizzontali, di cui l'ultima riga aggiorna il valore della distanza
+        hp = vn | ~(d0 | vp);
+        hn = d0 & vp;
+        if(hp & p->last)
+            score++;
+        else if(hn & p->last)
+            score--;
+
+        // differenze verticali della colonna successiva
+        hp = (hp << 1) | 1;
+        hn = hn << 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        oldPm = pm;
+
+        // l'ultima cella può diminuire al più di 1 per ogni carattere rimasto
+        if(score - (--remaining) > cutoff) return score - remaining;
+    }
 
-        for(j=0; s2[j] != '\0'; j++)
-        {
-            current_cost = (s1[i] != s2[j]);    // cost = 1 <--> s1[i] != s2[j]
+    return score;
+}
 
-            // se la casella in alto a sinistra di 2 posti esiste, considero anche l'operazione di swap
-            if(i>0 && j>0 && s1[i] == s2[j-1] && s1[i-1] == s2[j])
-                matrix[i+1][j+1] = minimum( minimum(matrix[i][j+1], matrix[i+1][j]) + 1,
-											minimum(matrix[i][j], matrix[i-1][j-1]) + current_cost );
-            // altrimenti significa che sto considerando il primo carattere di una stringa, quindi lo swap non è ammissibile
-            else
-                matrix[i+1][j+1] = minimum( minimum(matrix[i][j+1], matrix[i+1][j]) + 1, matrix[i][j] + current_cost );
+// variante SIMD (SSE2) che confronta la parola preparata con DL_LANES parole insieme, una per ogni intero del registro
+// (disattivabile definendo NO_SIMD)
+#if !defined(NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define DL_LANES 4
+
+// seleziona i valori di a nelle posizioni in cui mask ha tutti i bit a 1, quelli di b nelle altre
+#define blend(mask, a, b) _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+
+static void DL_distances(DLPattern *p, char *s[DL_LANES], int dist[DL_LANES])
+{
+    __m128i pm, oldPm, vp, vn, d0, hp, hn, tr, x, active, score, last, zero, one;
+    int i, j, maxLen, len[DL_LANES], c[DL_LANES];
+
+    maxLen = 0;
+    for(i=0; i<DL_LANES; i++)
+    {
+        len[i] = strlen(s[i]);
+        if(len[i] > maxLen) maxLen = len[i];
+    }
+
+    vp = _mm_set1_epi32(-1);
+    vn = d0 = oldPm = zero = _mm_setzero_si128();
+    one = _mm_set1_epi32(1);
+    last = _mm_set1_epi32((int) p->last);
+    score = _mm_set1_epi32(p->len);
+    for(j=0; j<maxLen; j++)
+    {
+        // le parole già terminate mantengono i valori che avevano (active = 0)
+        for(i=0; i<DL_LANES; i++)
+            c[i] = (j < len[i]) ? (unsigned char) s[i][j] : -1;
+        active = _mm_cmpgt_epi32(_mm_set_epi32(c[3], c[2], c[1], c[0]), _mm_set1_epi32(-1));
+        pm = _mm_set_epi32(p->peq[c[3] & 255], p->peq[c[2] & 255], p->peq[c[1] & 255], p->peq[c[0] & 255]);
+
+        // stessi passi di DL_distance su ogni intero del registro
+        tr = _mm_and_si128(_mm_slli_epi32(_mm_andnot_si128(d0, pm), 1), oldPm);
+        x = _mm_and_si128(pm, vp);
+        x = _mm_xor_si128(_mm_add_epi32(x, vp), vp);
+        x = _mm_or_si128(_mm_or_si128(x, pm), _mm_or_si128(vn, tr));
+
+        hp = _mm_or_si128(vn, _mm_xor_si128(_mm_or_si128(x, vp), _mm_set1_epi32(-1)));
+        hn = _mm_and_si128(x, vp);
+        score = _mm_sub_epi32(score, _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(hp, last), zero), active));
+        score = _mm_add_epi32(score, _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(hn, last), zero), active));
+
+        hp = _mm_or_si128(_mm_slli_epi32(hp, 1), one);
+        hn = _mm_slli_epi32(hn, 1);
+        d0 = blend(active, x, d0);
+        vp = blend(active, _mm_or_si128(hn, _mm_xor_si128(_mm_or_si128(x, hp), _mm_set1_epi32(-1))), vp);
+        vn = blend(active, _mm_and_si128(hp, x), vn);
+        oldPm = blend(active, pm, oldPm);
+    }
+
+    _mm_storeu_si128((__m128i *) dist, score);
+    if(p->len == 0)
+        for(i=0; i<DL_LANES; i++)
+            dist[i] = len[i];
+}
+#else
+#define DL_LANES 1
+#endif
+
+// distanza di Damerau-Levenshtein senza restrizioni, in cui anche i caratteri già scambiati possono essere modificati:
+// non supera mai quella di DL_distance e, a differenza di essa, rispetta la disuguaglianza triangolare
+static int DL_metric(char s1[], char s2[])
+{
+    int i, j, i1, j1, lastMatch, len1, len2, infinity, current_cost, matrix[MAX_WORD + 2][MAX_WORD + 2];
+    int lastRow[256];   // ultima riga di s1 in cui compare ogni carattere (0 se non è ancora comparso)
+
+    len1 = strlen(s1);
+    len2 = strlen(s2);
+    infinity = len1 + len2;
+    memset(lastRow, 0, sizeof(lastRow));
+
+    // la matrice ha una riga e una colonna in più, con valore "infinito", per gli scambi non ammissibili
+    matrix[0][0] = infinity;
+    for(i=0; i<=len1; i++)
+    {
+        matrix[i+1][0] = infinity;
+        matrix[i+1][1] = i;
+    }
+    for(j=0; j<=len2; j++)
+    {
+        matrix[0][j+1] = infinity;
+        matrix[1][j+1] = j;
+    }
+
+    for(i=1; i<=len1; i++)
+    {
+        lastMatch = 0;  // ultima colonna della riga corrente in cui s2 ha lo stesso carattere di s1
+        for(j=1; j<=len2; j++)
+        {
+            i1 = lastRow[(unsigned char) s2[j-1]];
+            j1 = lastMatch;
+            current_cost = (s1[i-1] != s2[j-1]);
+            if(current_cost == 0)
+                lastMatch = j;
+
+            // oltre alle operazioni di DL_distance considero lo scambio fra le ultime occorrenze dei due caratteri,
+            // cancellando o inserendo quelli che le separano
+            matrix[i+1][j+1] = minimum( minimum(matrix[i][j+1], matrix[i+1][j]) + 1, matrix[i][j] + current_cost );
+            matrix[i+1][j+1] = minimum( matrix[i+1][j+1], matrix[i1][j1] + (i - i1 - 1) + 1 + (j - j1 - 1) );
         }
+        lastRow[(unsigned char) s1[i-1]] = i;
     }
 
-    return matrix[i][j]; // la distanza di Damerau-Levenshtein si trova nell'ultima posizione della matrice
+    return matrix[len1+1][len2+1];
 }
 
 // inserimento ordinato di una parola nel vettore delle parole simili
@@ -55,7 +254,7 @@ static void orderedInsertion(int dist, char *word, int *d, char **r, int len)
         if(dist < d[i])
         {
             d[i-1] = d[i];
-            strcpy_s(r[i-1], sizeof(r[i - 1]), r[i]);
+            strcpy_s(r[i-1], MAX_WORD + 1, r[i]);
         }
         else
             break;
@@ -63,23 +262,512 @@ static void orderedInsertion(int dist, char *word, int *d, char **r, int len)
 
     // e alla fine inserisco la parola nella posizione corretta
     d[i-1] = dist;
-    strcpy_s(r[i-1], sizeof(r[i - 1]), word);
+    strcpy_s(r[i-1], MAX_WORD + 1, word);
 }
 
-// trova le tre parole dell'albero con minore distanza di Damerau-Levenshtein da quella inserita
-static void spellCheck(NODO *dictionary, char *w, int *d, char **r)
+// parola che può comparire fra le tre più simili, con la sua posizione nella visita in postordine fatta da spellCheck
+typedef struct
 {
+    NODO *node;
     int dist;
+    int order;
+} Candidate;
+
+// parole raccolte senza seguire l'ordine di spellCheck, da riconsiderare alla fine in quell'ordine
+typedef struct
+{
+    Candidate *v;
+    int n, size;
+    int best[3];    // le tre distanze minori trovate finora, dalla maggiore alla minore come in orderedInsertion
+} CandidateList;
+
+// inizializza una lista di candidati vuota
+static void candidateInit(CandidateList *c)
+{
+    c->v = NULL;
+    c->n = 0;
+    c->size = 0;
+    c->best[0] = c->best[1] = c->best[2] = MAX_WORD + 1;
+}
+
+// aggiunge la parola se non è più distante della terza più simile trovata, ritorna 1 in caso di errori di allocazione
+static int candidateAdd(CandidateList *c, NODO *node, int dist)
+{
+    Candidate *v;
+    int i;
+
+    if(dist > c->best[0]) return 0;
+
+    if(c->n == c->size)
+    {
+        v = (Candidate *) realloc(c->v, (c->size > 0 ? 2 * c->size : 16) * sizeof(Candidate));
+        if(v == NULL) return 1;
+        c->v = v;
+        c->size = (c->size > 0) ? 2 * c->size : 16;
+    }
+    c->v[c->n].node = node;
+    c->v[c->n].dist = dist;
+    c->n++;
+
+    for(i=1; i<3 && dist < c->best[i]; i++)
+        c->best[i-1] = c->best[i];
+    c->best[i-1] = dist;
+    return 0;
+}
+
+// posizione del nodo nella visita in postordine dell'albero: precedono il nodo i suoi due sottoalberi e, per ogni avo
+// di cui sta nel sottoalbero destro, il sottoalbero sinistro di quell'avo
+static int postorderRank(NODO *root, NODO *n)
+{
+    int rank;
+
+    rank = n->children[LEFT]->nodes + n->children[RIGHT]->nodes;
+    for(; n->father != root; n = n->father)
+        if(!isLeftChild(n))
+            rank += n->father->children[LEFT]->nodes;
+    return rank;
+}
+
+static int compareOrder(const void *a, const void *b)
+{
+    return ((Candidate *) a)->order - ((Candidate *) b)->order;
+}
+
+// passa a orderedInsertion i candidati nell'ordine di spellCheck, ottenendo le stesse tre parole anche a parità di
+// distanza; quelli più distanti della terza parola più simile non cambierebbero il risultato e vengono scartati
+static void replayCandidates(NODO *root, CandidateList *c, int *d, char **r)
+{
+    int i, n;
+
+    for(i=0, n=0; i<c->n; i++)
+        if(c->v[i].dist <= c->best[0])
+        {
+            c->v[n] = c->v[i];
+            c->v[n].order = postorderRank(root, c->v[n].node);
+            n++;
+        }
+
+    if(n > 1)
+        qsort(c->v, n, sizeof(Candidate), compareOrder);
+    for(i=0; i<n; i++)
+        orderedInsertion(c->v[i].dist, c->v[i].node->word, d, r, 3);
+}
+
+// stato della ricerca avanzata: parola cercata, vettori delle parole più simili (oppure lista dei candidati, se non
+// è NULL) e nodi in attesa di essere confrontati
+typedef struct
+{
+    DLPattern *pattern;
+    int *d;
+    char **r;
+    CandidateList *c;
+    NODO *pending[DL_LANES];
+    int n;
+    int error;  // 1 se non è stato possibile aggiungere un candidato
+} SpellState;
+
+// distanza oltre la quale una parola non può più entrare fra le tre più simili
+#define spellCutoff(s) (((s)->c == NULL) ? (s)->d[0] : (s)->c->best[0])
+
+// confronta i nodi in attesa con la parola cercata e li inserisce nell'ordine in cui sono stati visitati
+static void spellFlush(SpellState *s)
+{
+    int i, dist[DL_LANES];
+#if DL_LANES > 1
+    char *words[DL_LANES];
+
+    if(s->n == DL_LANES)
+    {
+        for(i=0; i<DL_LANES; i++)
+            words[i] = s->pending[i]->word;
+        DL_distances(s->pattern, words, dist);
+    }
+#endif
+
+    for(i=0; i<s->n; i++)
+    {
+        if(s->n < DL_LANES || DL_LANES == 1)
+            dist[i] = DL_distance(s->pattern, s->pending[i]->word, spellCutoff(s));
+
+        if(s->c == NULL)
+            orderedInsertion(dist[i], s->pending[i]->word, s->d, s->r, 3);
+        else if(candidateAdd(s->c, s->pending[i], dist[i]) != 0)
+            s->error = 1;
+    }
+    s->n = 0;
+}
+
+// aggiunge un nodo a quelli da confrontare, a meno che la differenza di lunghezza non basti già a escluderlo
+// (la distanza limite può solo diminuire, quindi il nodo non entrerebbe nemmeno fra le parole più simili)
+static void spellVisit(SpellState *s, NODO *n)
+{
+    if(abs((int) strlen(n->word) - s->pattern->len) > spellCutoff(s)) return;
+
+    s->pending[s->n++] = n;
+    if(s->n == DL_LANES)
+        spellFlush(s);
+}
+
+// trova le tre parole dell'albero con minore distanza di Damerau-Levenshtein da quella inserita
+// (i nodi vengono confrontati a gruppi di DL_LANES, quindi alla fine bisogna chiamare spellFlush per gli ultimi)
+static void spellCheck(NODO *root, NODO *dictionary, SpellState *s)
+{
+    if(dictionary == root) return; // caso base e chiamate ricorsive
+    spellCheck(root, dictionary->children[LEFT], s);
+    spellCheck(root, dictionary->children[RIGHT], s);
+
+    // aggiungo la parola corrente a quelle da confrontare con la parola inserita e, quando il gruppo è completo,
+    // inserisco le parole nel vettore che contiene le 3 parole più simili (dalla meno simile alla più simile)
+    spellVisit(s, dictionary);
+}
+
+// parola cercata da searchAdvanceBatch: i puntatori r indicano le parole del suo risultato, in ordine inverso
+typedef struct
+{
+    DLPattern pattern;  // con len = -1 se la parola è troppo lunga per essere cercata
+    int d[3];
+    char *r[3];
+} BatchQuery;
+
+// ricerca avanzata di più parole insieme: le parole del dizionario sono copiate a blocchi, in ordine di visita, in un
+// vettore abbastanza piccolo da restare in cache mentre viene confrontato con tutte le parole cercate
+typedef struct
+{
+    BatchQuery *queries;
+    int n;
+    char block[SPELL_BLOCK][MAX_WORD + 1];
+    int len[SPELL_BLOCK];
+    int count;
+} BatchState;
+
+// confronta il blocco corrente con tutte le parole cercate, ognuna con la propria distanza limite
+static void batchFlush(BatchState *b)
+{
+    BatchQuery *q;
+    int i, j;
+
+    for(j=0; j<b->n; j++)
+    {
+        q = &b->queries[j];
+        if(q->pattern.len < 0) continue;
+
+        for(i=0; i<b->count; i++)
+            if(abs(b->len[i] - q->pattern.len) <= q->d[0])
+                orderedInsertion(DL_distance(&q->pattern, b->block[i], q->d[0]), b->block[i], q->d, q->r, 3);
+    }
+    b->count = 0;
+}
+
+// visita l'albero in postordine come spellCheck, aggiungendo le parole al blocco corrente
+static void batchCheck(NODO *root, NODO *dictionary, BatchState *b)
+{
+    if(dictionary == root) return;
+    batchCheck(root, dictionary->children[LEFT], b);
+    batchCheck(root, dictionary->children[RIGHT], b);
+
+    strcpy_s(b->block[b->count], MAX_WORD + 1, dictionary->word);
+    b->len[b->count] = strlen(dictionary->word);
+    if(++b->count == SPELL_BLOCK)
+        batchFlush(b);
+}
+
+// thread della ricerca avanzata parallela: i sottoalberi da visitare sono presi uno alla volta dal vettore comune,
+// quindi chi finisce prima continua con quelli rimasti e i thread restano occupati anche se hanno dimensioni diverse
+typedef struct
+{
+    NODO *root;
+    NODO **tasks;
+    int nTasks;
+    int *next;  // primo sottoalbero non ancora preso, comune a tutti i thread
+    DLPattern *pattern;
+    CandidateList c;
+    int error;
+} SpellWorker;
+
+static THREAD_FUNC spellWorker(void *arg)
+{
+    SpellWorker *w;
+    SpellState s;
+    int i;
+
+    w = (SpellWorker *) arg;
+    candidateInit(&w->c);
+    s.pattern = w->pattern;
+    s.c = &w->c;
+    s.n = 0;
+    s.error = 0;
+    while((i = atomicIncrement(w->next)) < w->nTasks)
+        spellCheck(w->root, w->tasks[i], &s);
+    spellFlush(&s);
+
+    w->error = s.error;
+    return 0;
+}
+
+// salva in tasks i sottoalberi a profondità depth (o le foglie meno profonde) e confronta subito i nodi sopra di essi
+static void spellSplit(NODO *root, NODO *n, int depth, NODO **tasks, int *nTasks, SpellState *s)
+{
+    if(n == root) return;
+
+    if(depth == 0 || n->nodes == 1)
+    {
+        tasks[(*nTasks)++] = n;
+        return;
+    }
+    spellSplit(root, n->children[LEFT], depth - 1, tasks, nTasks, s);
+    spellSplit(root, n->children[RIGHT], depth - 1, tasks, nTasks, s);
+    spellVisit(s, n);
+}
+
+// ordina i sottoalberi dal più grande, in modo che alla fine restino da visitare solo quelli piccoli
+static int compareSize(const void *a, const void *b)
+{
+    return (*(NODO **) b)->nodes - (*(NODO **) a)->nodes;
+}
+
+// ricerca avanzata divisa fra nThreads thread (compreso quello chiamante): ognuno raccoglie i propri candidati,
+// che alla fine sono riuniti e riconsiderati nell'ordine di spellCheck; ritorna 1 in caso di errori di allocazione
+static int parallelSpellCheck(NODO *root, NODO *dictionary, DLPattern *pattern, int *d, char **r, int nThreads)
+{
+    SpellWorker *workers;
+    SpellState s;
+    CandidateList all;
+    Thread *threads;
+    NODO **tasks;
+    int i, j, depth, nTasks, next, error;
+    char *started;
+
+    // con SPELL_TASKS sottoalberi per thread, chi resta senza lavoro aspetta al più uno dei sottoalberi più piccoli
+    for(depth = 0; (1 << depth) < nThreads * SPELL_TASKS; depth++);
+    tasks = (NODO **) malloc((1 << depth) * sizeof(NODO *));
+    workers = (SpellWorker *) malloc(nThreads * sizeof(SpellWorker));
+    threads = (Thread *) malloc(nThreads * sizeof(Thread));
+    started = (char *) calloc(nThreads, sizeof(char));
+    if(tasks == NULL || workers == NULL || threads == NULL || started == NULL)
+    {
+        free(tasks);
+        free(workers);
+        free(threads);
+        free(started);
+        return 1;
+    }
+
+    // i nodi sopra i sottoalberi finiscono fra i candidati del thread chiamante
+    candidateInit(&all);
+    s.pattern = pattern;
+    s.c = &all;
+    s.n = 0;
+    s.error = 0;
+    nTasks = 0;
+    spellSplit(root, dictionary, depth, tasks, &nTasks, &s);
+    spellFlush(&s);
+    qsort(tasks, nTasks, sizeof(NODO *), compareSize);
+
+    // se un thread non parte i suoi sottoalberi vengono visitati dagli altri
+    next = 0;
+    for(i=0; i<nThreads; i++)
+    {
+        workers[i].root = root;
+        workers[i].tasks = tasks;
+        workers[i].nTasks = nTasks;
+        workers[i].next = &next;
+        workers[i].pattern = pattern;
+        if(i > 0)
+            started[i] = threadStart(threads[i], spellWorker, &workers[i]);
+    }
+    spellWorker(&workers[0]);
+    started[0] = 1;
+
+    error = s.error;
+    for(i=0; i<nThreads; i++)
+        if(started[i])
+        {
+            if(i > 0)
+                threadJoin(threads[i]);
+            for(j=0; j<workers[i].c.n && !error; j++)
+                error = candidateAdd(&all, workers[i].c.v[j].node, workers[i].c.v[j].dist);
+            error |= workers[i].error;
+            free(workers[i].c.v);
+        }
+
+    if(!error)
+        replayCandidates(root, &all, d, r);
+    free(all.v);
+    free(tasks);
+    free(workers);
+    free(threads);
+    free(started);
+    return error;
+}
 
-    if(strcmp(dictionary->word, SENTINEL) == 0) return; // caso base e chiamate ricorsive
-    spellCheck(dictionary->children[LEFT], w, d, r);
-    spellCheck(dictionary->children[RIGHT], w, d, r);
+/// FUNZIONI STATICHE PER LA LETTURA DEI FILE
 
-    // calcolo la distanza di Damerau-Levenshtein fra la parola corrente e quella inserita
-    dist = DL_distance(dictionary->word, w);
+// contenuto di un file in memoria: mappato quando il sistema lo permette, altrimenti letto con una sola fread in un
+// buffer allocato; i dati vengono poi analizzati direttamente in memoria, senza altre chiamate di sistema né copie
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t pos;     // posizione di lettura corrente
+    int mapped;     // 1 se data è la mappatura del file
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+} MappedFile;
+
+// prova a mappare il file, ritorna 1 se non è possibile (anche perché è vuoto)
+static int mapRegion(MappedFile *m, char *name)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    void *data;
+
+    m->file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(m->file == INVALID_HANDLE_VALUE) return 1;
+    m->mapping = NULL;
+    if(GetFileSizeEx(m->file, &size) && size.QuadPart > 0 && (unsigned long long) size.QuadPart <= (size_t) -1)
+        m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    data = NULL;
+    if(m->mapping != NULL)
+        data = MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == NULL)
+    {
+        if(m->mapping != NULL)
+            CloseHandle(m->mapping);
+        CloseHandle(m->file);
+        return 1;
+    }
+
+    // data e size vengono impostati solo se la mappatura è riuscita, altrimenti openFile legge il file da capo
+    m->data = (unsigned char *) data;
+    m->size = (size_t) size.QuadPart;
+    return 0;
+#else
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(name, O_RDONLY);
+    if(fd < 0) return 1;
+    data = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0 && (unsigned long long) st.st_size <= (size_t) -1)
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // la mappatura resta valida anche dopo la chiusura del file
+    if(data == MAP_FAILED) return 1;
+
+    // data e size vengono impostati solo se la mappatura è riuscita, altrimenti openFile legge il file da capo
+    m->data = (unsigned char *) data;
+    m->size = (size_t) st.st_size;
+    return 0;
+#endif
+}
+
+// apre il file in lettura e ne rende disponibile il contenuto, ritorna 1 in caso di errori
+static int openFile(MappedFile *m, char *name)
+{
+    FILE *f;
+    unsigned char *t;
+    size_t size, n;
+
+    m->data = NULL;
+    m->size = 0;
+    m->pos = 0;
+    m->mapped = 0;
+    if(mapRegion(m, name) == 0)
+    {
+        m->mapped = 1;
+        return 0;
+    }
+
+    // in alternativa leggo l'intero file in un buffer, ingrandito finché la lettura non lo riempie
+    m->data = NULL;
+    m->size = 0;
+    fopen_s(&f, name, "rb");
+    if(f == NULL) return 1;
+    size = IO_BUFFER;
+    while(1)
+    {
+        t = (unsigned char *) realloc(m->data, size);
+        if(t == NULL)
+        {
+            free(m->data);
+            fclose(f);
+            return 1;
+        }
+        m->data = t;
+        n = fread(m->data + m->size, 1, size - m->size, f);
+        m->size += n;
+        if(m->size < size) break;
+        size *= 2;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void closeFile(MappedFile *m)
+{
+    if(!m->mapped)
+    {
+        free(m->data);
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m->data);
+    CloseHandle(m->mapping);
+    CloseHandle(m->file);
+#else
+    munmap(m->data, m->size);
+#endif
+}
+
+// ritorna una copia allocata del nome del file seguito da suffix (NULL in caso di errori)
+static char* fileName(char *name, char *suffix)
+{
+    char *s;
+    size_t len;
+
+    len = strlen(name);
+    s = (char *) malloc(len + strlen(suffix) + 1);
+    if(s == NULL) return NULL;
+    memcpy(s, name, len);
+    strcpy_s(s + len, strlen(suffix) + 1, suffix);
+    return s;
+}
+
+// rende persistente su disco la directory che contiene il file name, così che un file appena rinominato in name non
+// possa tornare quello precedente dopo un'interruzione; ritorna 1 in caso di errori (su Windows lo fa già replaceFile
+// con MOVEFILE_WRITE_THROUGH)
+static int syncDirectory(char *name)
+{
+#ifdef _WIN32
+    (void) name;
+    return 0;
+#else
+    char *dir, *slash;
+    int fd, error;
+
+    dir = fileName(name, "");
+    if(dir == NULL) return 1;
+    slash = strrchr(dir, '/');
+    if(slash == dir)
+        slash[1] = '\0';  // il file è nella radice
+    else if(slash != NULL)
+        *slash = '\0';
+    fd = open((slash != NULL) ? dir : ".", O_RDONLY);
+    free(dir);
+    if(fd < 0) return 1;
+
+    error = (fsync(fd) != 0);
+    error = (close(fd) != 0) || error;
+    return error;
+#endif
+}
 
-    // inserisco la parola nel vettore che contiene le 3 parole più simili (dalla meno simile alla più simile)
-    orderedInsertion(dist, dictionary->word, d, r, 3);
+// ritorna il prossimo byte del file, EOF se è finito
+static int nextByte(MappedFile *m)
+{
+    if(m->pos >= m->size) return EOF;
+    return m->data[m->pos++];
 }
 
 /// FUNZIONI STATICHE PER CODIFICA DI HUFFMAN
@@ -173,46 +861,23 @@ static HuffNode* extractMin(HuffNode *h[], int *dim)
 }
 
 // FUNZIONI PER LA CODIFICA
-static void getFrequences(NODO *n, HuffNode *f[])
+// aggiunge a f[] le occorrenze dei caratteri delle n voci in v[]
+static void getFrequences(NODO **v, int n, int f[])
 {
-    int i, pos;
-
-    if(strcmp(n->word, SENTINEL) == 0) return;  // caso base e chiamate ricorsive
-    getFrequences(n->children[LEFT], f);
-    getFrequences(n->children[RIGHT], f);
-
-    // in ogni posizione i è contenuto l'i-esimo carattere in codifica ASCII
-    for(i=0; n->word[i] != '\0'; i++)
-    {
-        pos = (int) n->word[i];
+    unsigned char *c;
+    int i;
 
-        // se non ho già allocato il nodo lo alloco con frequenza 1
-        if(f[pos] == NULL)
-        {
-            f[pos] = huffAlloc(pos, 1);
-            if(f[pos] == NULL) return;
-        }
-        // altrimenti aumento la frequenza
-        else
-            f[pos]->frequence++;
-    }
-    // ripeto lo stesso procedimento per la definizione
-    for(i=0; n->def[i] != '\0'; i++)
+    for(i = 0; i < n; i++)
     {
-        pos = (int) n->def[i];
-
-        // se non ho già allocato il nodo lo alloco con frequenza 1
-        if(f[pos] == NULL)
-        {
-            f[pos] = huffAlloc(pos, 1);
-            if(f[pos] == NULL) return;
-        }
-        // altrimenti aumento la frequenza
-        else
-            f[pos]->frequence++;
+        // in ogni posizione i è contenuto l'i-esimo carattere in codifica ASCII
+        for(c = (unsigned char *) v[i]->word; *c != '\0'; c++)
+            f[*c]++;
+        // ripeto lo stesso procedimento per la definizione
+        for(c = (unsigned char *) v[i]->def; *c != '\0'; c++)
+            f[*c]++;
     }
-    f['[']->frequence++;    // aggiungo le frequenze per le [] intorno alla definizione
-    f[']']->frequence++;
+    f['['] += n;    // aggiungo le frequenze per le [] intorno alle definizioni
+    f[']'] += n;
 }
 
 static HuffNode *createHuffmanEncTree(HuffNode *f[], int dim)
@@ -238,94 +903,195 @@ static HuffNode *createHuffmanEncTree(HuffNode *f[], int dim)
     return extractMin(f, &dim);
 }
 
-static void saveCharactersMap(char *m[], HuffNode *h, char code[], int pos, FILE *f)
+// codice di un carattere: i suoi len bit sono quelli meno significativi di bits (con frequenze di tipo int l'albero
+// non supera i 46 livelli, quindi un codice sta sempre in un intero a 64 bit insieme a meno di un byte in attesa)
+typedef struct
+{
+    unsigned long long bits;
+    int len;
+} HuffCode;
+
+// salva in lengths[] la lunghezza del codice di ogni lettera, cioè la profondità della sua foglia
+static void codeLengths(HuffNode *h, int depth, unsigned char lengths[])
 {
-	int i;
     // se il nodo non ha figli (h->left == h->right == NULL perché ogni nodo ha solo 0 o 2 figli)
     if(h->children[LEFT] == NULL)
     {
-		i = (int) h->letter;
-		code[pos] = '\0';
-
-        // copio nella casella corrispondente alla lettera il suo codice (tramite il puntatore c che alloco)
-		m[i] = (char *) malloc((pos + 1) * sizeof(char));
-        if(m[i] == NULL) return;
-        strcpy_s(m[i], (pos + 1) * sizeof(char), code);
-
-        // e salvo nel file la mappa con le associazioni lettera/codice
-        fwrite(m[(int) h->letter], sizeof(char), pos, f);
-        fwrite(&(h->letter), sizeof(char), 1, f);
+        lengths[(unsigned char) h->letter] = depth;
         return;
     }
 
-    // altrimenti scendo nei nodi figli (che esistono entrambi) dopo aver aggiunto 0 o 1 al codice
-    code[pos] = '0';
-    saveCharactersMap(m, h->children[LEFT], code, pos+1, f);
+    codeLengths(h->children[LEFT], depth + 1, lengths);
+    codeLengths(h->children[RIGHT], depth + 1, lengths);
+}
+
+// assegna i codici canonici: le lettere, ordinate per lunghezza del codice e poi per valore, ricevono codici
+// consecutivi, quindi per ricostruirli bastano le lunghezze; ritorna 1 se queste non formano un codice prefisso
+static int canonicalCodes(unsigned char lengths[], HuffCode m[])
+{
+    unsigned long long code;
+    int i, len, prev;
+
+    for(i=0; i<ALPHABET; i++)
+        if(lengths[i] > HUFF_MAX_CODE) return 1;
+
+    code = 0;
+    prev = 0;
+    for(len = 1; len <= HUFF_MAX_CODE; len++)
+        for(i=0; i<ALPHABET; i++)
+            if(lengths[i] == len)
+            {
+                // passando a codici più lunghi aggiungo degli 0 in fondo, così nessun codice è prefisso di un altro
+                code <<= len - prev;
+                prev = len;
+                if((code >> len) != 0) return 1;
 
-    code[pos] = '1';
-    saveCharactersMap(m, h->children[RIGHT], code, pos+1, f);
+                m[i].bits = code++;
+                m[i].len = len;
+            }
+    return 0;
 }
 
-static void addSequenceofBits(char *t, int *k, char *c, char *m[], FILE *f)
+// scrittura a bit: i codici si accumulano in un intero a 64 bit, da cui passano 32 bit alla volta in un buffer in
+// memoria che viene scritto sul file solo quando è pieno
+typedef struct
+{
+    unsigned long long acc; // bit in attesa, allineati a destra (quelli più in alto non contano)
+    int count;              // numero di bit in attesa (sempre meno di 32 fra una chiamata e l'altra)
+    unsigned char buffer[IO_BUFFER];
+    size_t used;            // byte occupati nel buffer (ne restano sempre almeno 4 liberi fra una chiamata e l'altra)
+    long long written;      // byte già scritti sul file: le posizioni dei blocchi sono ricavate da qui e non da
+                            // ftell, che su Windows ritorna un long a 32 bit e non supera i 2 GB
+    FILE *f;                // se è NULL i byte vengono accodati in memory, che è ingrandito quando serve
+    unsigned char *memory;  // i primi written byte sono quelli scritti
+    size_t memorySize;
+    int error;              // 1 se una scrittura sul file o un'allocazione non è andata a buon fine
+} BitWriter;
+
+static void startWriter(BitWriter *w, FILE *f)
 {
-    int i, j, pos;
+    w->acc = 0;
+    w->count = 0;
+    w->used = 0;
+    w->written = 0;
+    w->f = f;
+    w->memory = NULL;
+    w->memorySize = 0;
+    w->error = 0;
+}
 
-    // per ogni lettera in t
-    for(i=0; t[i] != '\0'; i++)
-    {
-        pos = (int) t[i];
+static void flushBits(BitWriter *w)
+{
+    unsigned char *m;
+    size_t size;
 
-        // per ogni bit nel codice
-        for(j=0; m[pos][j] != '\0'; j++)
+    if(w->used > 0 && w->f != NULL && fwrite(w->buffer, 1, w->used, w->f) != w->used)
+        w->error = 1;
+    if(w->used > 0 && w->f == NULL)
+    {
+        // la memoria raddoppia ogni volta che il numero di byte scritti supera la sua dimensione
+        for(size = IO_BUFFER; size < (size_t) w->written + w->used; size *= 2);
+        if(size > w->memorySize)
         {
-            // shifto a sinistra il carattere c e aggiungo in fondo uno 0 o un 1 a seconda del bit map[pos][j] (= '0' o '1')
-            *c <<= 1;
-            *c |= (m[pos][j] - '0');
-            (*k)++;
-
-            // quando ho completato l'intero carattere lo stampo sul file
-            if(*k == BITSEQUENCE_LENGTH)
+            m = (unsigned char *) realloc(w->memory, size);
+            if(m == NULL)
+                w->error = 1;
+            else
             {
-                fwrite(c, sizeof(char), 1, f);
-                *k = 0;
+                w->memory = m;
+                w->memorySize = size;
             }
         }
+        if(!w->error)
+            memcpy(w->memory + w->written, w->buffer, w->used);
+    }
+    w->written += w->used;
+    w->used = 0;
+}
+
+// aggiunge len bit (al più 32, così l'accumulatore non trabocca) e sposta nel buffer i primi 32 quando ci sono
+static void putBits(BitWriter *w, unsigned long long bits, int len)
+{
+    unsigned int v;
+
+    w->acc = (w->acc << len) | bits;
+    w->count += len;
+    if(w->count >= 32)
+    {
+        w->count -= 32;
+        v = (unsigned int) (w->acc >> w->count);
+        w->buffer[w->used] = (unsigned char) (v >> 24);
+        w->buffer[w->used + 1] = (unsigned char) (v >> 16);
+        w->buffer[w->used + 2] = (unsigned char) (v >> 8);
+        w->buffer[w->used + 3] = (unsigned char) v;
+        w->used += 4;
+        if(w->used + 4 > IO_BUFFER)
+            flushBits(w);
     }
 }
 
-// k = bit fino al quale ho scritto i dati nel carattere c; c = carattere su cui sto scrivendo i bit
-static void encode(NODO *n, char *m[], int *k, char *c, FILE *f)
+// aggiunge un codice di lunghezza qualsiasi
+static void putCode(BitWriter *w, HuffCode *code)
+{
+    if(code->len > 32)
+        putBits(w, code->bits >> 32, code->len - 32);
+    putBits(w, code->bits & 0xFFFFFFFFull, (code->len > 32) ? 32 : code->len);
+}
+
+// aggiunge i codici di tutte le lettere di t
+static void putString(BitWriter *w, HuffCode m[], char *t)
+{
+    for(; *t != '\0'; t++)
+        putCode(w, &m[(unsigned char) *t]);
+}
+
+// scrive i byte completi rimasti e completa l'ultimo con degli 0, così i bit successivi iniziano da un nuovo byte
+static void alignBits(BitWriter *w)
 {
-    if(strcmp(n->word, SENTINEL) == 0) return;  // caso base e chiamate ricorsive
-    encode(n->children[LEFT], m, k, c, f);
-    encode(n->children[RIGHT], m, k, c, f);
+    for(; w->count >= BITSEQUENCE_LENGTH; w->count -= BITSEQUENCE_LENGTH)
+        w->buffer[w->used++] = (unsigned char) (w->acc >> (w->count - BITSEQUENCE_LENGTH));
+    if(w->count > 0)
+        w->buffer[w->used++] = (unsigned char) (w->acc << (BITSEQUENCE_LENGTH - w->count));
+    w->count = 0;
+    if(w->used + 4 > IO_BUFFER)
+        flushBits(w);
+}
+
+// aggiunge un numero senza segno di bytes byte, dal più significativo
+static void putNumber(BitWriter *w, unsigned long long v, int bytes)
+{
+    for(bytes--; bytes >= 0; bytes--)
+        putBits(w, (v >> (bytes * BITSEQUENCE_LENGTH)) & 0xFF, BITSEQUENCE_LENGTH);
+}
 
-    // codifico la stringa "word[def]"
-    addSequenceofBits(n->word, k, c, m, f);
-    addSequenceofBits("[", k, c, m, f);
-    addSequenceofBits(n->def, k, c, m, f);
-    addSequenceofBits("]", k, c, m, f);
+// aggiunge la voce "word[def]"
+static void putEntry(BitWriter *w, HuffCode m[], NODO *n)
+{
+    putString(w, m, n->word);
+    putCode(w, &m['[']);
+    putString(w, m, n->def);
+    putCode(w, &m[']']);
 }
 
 // FUNZIONI PER LA DECODIFICA
-static HuffNode* createHuffmanDecTree(FILE *f)
+// ricostruisce l'albero dalla mappa testuale dei codici dei file nel vecchio formato
+static HuffNode* createHuffmanDecTree(MappedFile *f)
 {
     HuffNode *temp, *head;
-    char letter;
-    int dir;
+    int letter, dir;
 
     head = huffAlloc('\0', 0);
     temp = head;
     if(head == NULL) return NULL;
 
-    fread(&letter, sizeof(char), 1, f);
-    while(letter != DIVIDER || feof(f))    // ripeto finché non trovo il divisore
+    letter = nextByte(f);
+    while(letter != DIVIDER && letter != EOF)    // ripeto finché non trovo il divisore (o finisce il file)
     {
         // se il carattere letto non fa parte del codice (!= '0','1'), allora sono in una foglia
         if(letter!='0' && letter!='1')
         {
             // salvo nella foglia il valore della lettera trovata
-            temp->letter = letter;
+            temp->letter = (char) letter;
             temp->children[LEFT] = NULL;
             temp->children[RIGHT] = NULL;
             temp = head;    // torno alla testa per il prossimo codice
@@ -343,649 +1109,4460 @@ static HuffNode* createHuffmanDecTree(FILE *f)
             temp = temp->children[dir];
         }
 
-        fread(&letter, sizeof(char), 1, f); // passo alla lettera successiva
+        letter = nextByte(f); // passo alla lettera successiva
     }
 
     return head;
 }
 
-static char decodeChar(HuffNode *t, char *c, int *k, FILE *f)
+// posto di una tabella di decodifica, indicizzata dai prossimi HUFF_TABLE_BITS bit: contiene la lettera il cui codice
+// inizia con quei bit oppure, se il codice è più lungo, la posizione della sottotabella per i bit successivi
+typedef struct
+{
+    int value;          // lettera o posizione della sottotabella
+    unsigned char len;  // bit da consumare (0 se nessun codice inizia con questi bit)
+    unsigned char sub;  // 1 se value è la posizione di una sottotabella
+} HuffEntry;
+
+// tabelle di decodifica, tutte nello stesso vettore (quella principale parte dalla posizione 0)
+typedef struct
+{
+    HuffEntry *v;
+    int n, size;
+} HuffTable;
+
+// aggiunge una tabella vuota e ne ritorna la posizione (-1 in caso di errori di allocazione)
+static int huffTable(HuffTable *t)
 {
-    // quando mi trovo su una foglia salvo la lettera e ritorno alla radice
-    while(t->children[LEFT] != NULL)
+    HuffEntry *v;
+    int start;
+
+    if(t->n + (1 << HUFF_TABLE_BITS) > t->size)
     {
-        t = t->children[*c < 0];   // dir è il primo bit del carattere letto (1 se c<0)
-        (*k)++;
-        *c <<= 1;
+        v = (HuffEntry *) realloc(t->v, (t->size + (1 << HUFF_TABLE_BITS)) * 2 * sizeof(HuffEntry));
+        if(v == NULL) return -1;
+        t->v = v;
+        t->size = (t->size + (1 << HUFF_TABLE_BITS)) * 2;
+    }
+    start = t->n;
+    t->n += 1 << HUFF_TABLE_BITS;
+    memset(&t->v[start], 0, (1 << HUFF_TABLE_BITS) * sizeof(HuffEntry));
+    return start;
+}
 
-        // quando ho leto tutti i bit passo al carattere successivo
-        if(*k == BITSEQUENCE_LENGTH)
+// aggiunge il codice della lettera, che occupa tutti i posti che iniziano con i suoi bit nell'ultima tabella in cui
+// arriva (quelli più lunghi di HUFF_TABLE_BITS passano da una sottotabella per ogni HUFF_TABLE_BITS bit)
+// ritorna 1 in caso di errori di allocazione
+static int huffInsert(HuffTable *t, int letter, HuffCode *c)
+{
+    int i, start, sub, pos, rest;
+
+    start = 0;
+    for(rest = c->len; rest > HUFF_TABLE_BITS; start = t->v[pos].value)
+    {
+        rest -= HUFF_TABLE_BITS;
+        pos = start + (int) ((c->bits >> rest) & ((1 << HUFF_TABLE_BITS) - 1));
+        if(!t->v[pos].sub)
         {
-            *k = 0;
-            fread(c, sizeof(char), 1, f);
+            sub = huffTable(t);    // la creazione può spostare il vettore, quindi uso solo posizioni
+            if(sub < 0) return 1;
+            t->v[pos].value = sub;
+            t->v[pos].len = HUFF_TABLE_BITS;
+            t->v[pos].sub = 1;
         }
     }
 
-    return t->letter;
+    pos = start + ((int) (c->bits & ((1 << rest) - 1)) << (HUFF_TABLE_BITS - rest));
+    for(i = 0; i < 1 << (HUFF_TABLE_BITS - rest); i++)
+    {
+        t->v[pos + i].value = letter;
+        t->v[pos + i].len = rest;
+        t->v[pos + i].sub = 0;
+    }
+    return 0;
 }
 
-/// FUNZIONI STATICHE PER RED-BLACK TREES
+// salva in m[] i codici delle foglie dell'albero letto da un file nel vecchio formato
+static void treeCodes(HuffNode *h, unsigned long long code, int depth, HuffCode m[])
+{
+    if(h == NULL || depth > HUFF_MAX_CODE) return;  // albero incompleto o non valido
+
+    if(h->children[LEFT] == NULL)
+    {
+        m[(unsigned char) h->letter].bits = code;
+        m[(unsigned char) h->letter].len = depth;
+        return;
+    }
+    treeCodes(h->children[LEFT], code << 1, depth + 1, m);
+    treeCodes(h->children[RIGHT], (code << 1) | 1, depth + 1, m);
+}
 
-// alloca un nuovo nodo con valori predefiniti
-static NODO* nodeAlloc(NODO *root, char *w, char *def)
+// legge l'intestazione del file e crea le tabelle di decodifica, ritorna la versione del file (-1 in caso di errori)
+// dopo il byte di versione ci sono le lunghezze dei codici canonici delle lettere (tutti i byte nei file HUFF_WIDE,
+// che per il resto sono uguali ai HUFF_FRAMED e sono riportati come tali, i primi HUFF_NARROW negli altri); i file
+// delle versioni precedenti iniziano invece con la mappa testuale dei codici, da cui viene ricostruito l'albero
+// (versione 1)
+static int readHeader(MappedFile *f, HuffTable *t)
 {
-    NODO *node;
+    HuffCode codes[256];
+    HuffNode *tree;
+    unsigned char lengths[ALPHABET];
+    size_t letters;
+    int i, version;
 
-    node = (NODO*) malloc(sizeof(NODO));
-    if(node == NULL) return NULL;
+    memset(codes, 0, sizeof(codes));
+    version = nextByte(f);
+    if(version == EOF) return -1;
 
-    strcpy_s(node->word, sizeof(node->word), w);
-    strcpy_s(node->def, sizeof(node->def), def);
-    node->father = NULL;
-    node->children[LEFT] = root; // le foglie puntano alla sentinella, in questo modo si ha una struttura circolare
-    node->children[RIGHT] = root; // e non sono necessari i controlli su NULL
-    node->color = RED;   // i nodi inseriti hanno inizialmente colore rosso
-    node->nodes = 1;    // inizialmente nel sottoalbero radicato in node c'è solo esso stesso
-    return node;
+    if(version == HUFF_VERSION || version == HUFF_FRAMED || version == HUFF_WIDE)
+    {
+        letters = (version == HUFF_WIDE) ? ALPHABET : HUFF_NARROW;
+        if(f->size - f->pos < letters) return -1;
+        memset(lengths, 0, sizeof(lengths));
+        memcpy(lengths, f->data + f->pos, letters);
+        f->pos += letters;
+        if(canonicalCodes(lengths, codes) != 0) return -1;
+        if(version == HUFF_WIDE)
+            version = HUFF_FRAMED;
+    }
+    else
+    {
+        f->pos--;
+        version = 1;
+        tree = createHuffmanDecTree(f);
+        if(tree == NULL) return -1;
+        treeCodes(tree, 0, 0, codes);
+        huffDealloc(tree);
+    }
+
+    if(huffTable(t) < 0) return -1;
+    for(i=0; i<256; i++)
+        if(codes[i].len > 0 && huffInsert(t, i, &codes[i]) != 0) return -1;
+    return version;
 }
 
-// inizializza un nuovo RBT
-static NODO* init()
+// legge un numero senza segno di bytes byte, dal più significativo; ritorna 1 se il file finisce prima
+static int readNumber(MappedFile *f, int bytes, unsigned long long *v)
 {
-    NODO *n;
-
-    // inizializzo una sentinella di colore nero con valore SENTINEL (ha se stessa come figli e conta sempre 0 nodi)
-    n = nodeAlloc(NULL, SENTINEL, "");
-    if(n == NULL) return NULL;
+    int c;
 
-    n->children[0] = n;
-    n->children[1] = n;
-    n->nodes = 0;
-    n->color = BLACK;
-    return n;
+    for(*v = 0; bytes > 0; bytes--)
+    {
+        c = nextByte(f);
+        if(c == EOF) return 1;
+        *v = (*v << BITSEQUENCE_LENGTH) | (unsigned long long) c;
+    }
+    return 0;
 }
 
-// presa in input la sentinella, ritorna la testa del RBT
-static NODO *head(NODO *root)
+// indice dei file a blocchi: posizione nel file e prima parola di ogni blocco
+typedef struct
 {
-    return root->children[RIGHT]; // poiché la sentinella ha valore "" (0) tutti i suoi figli sono a destra
+    long long *offsets;
+    char (*keys)[MAX_WORD + 1];
+    int n;
+} HuffIndex;
+
+// legge l'indice che si trova in fondo al file, ritorna 1 in caso di errori
+static int readIndex(MappedFile *f, HuffIndex *x)
+{
+    unsigned long long position, n, v;
+    int len;
+
+    x->offsets = NULL;
+    x->keys = NULL;
+    x->n = 0;
+    if(f->size < HUFF_TRAILER) return 1;
+    f->pos = f->size - HUFF_TRAILER;
+    if(readNumber(f, 8, &position) != 0 || readNumber(f, 4, &n) != 0 || n > INT_MAX / (MAX_WORD + 1) ||
+       position > f->size - HUFF_TRAILER)
+        return 1;
+    f->pos = (size_t) position;
+
+    x->offsets = (long long *) malloc((n + 1) * sizeof(long long));
+    x->keys = malloc((n + 1) * sizeof(*x->keys));
+    if(x->offsets == NULL || x->keys == NULL) return 1;
+
+    for(x->n = 0; x->n < (int) n; x->n++)
+    {
+        if(readNumber(f, 8, &v) != 0 || v >= position) return 1;
+        x->offsets[x->n] = (long long) v;
+        len = nextByte(f);
+        if(len == EOF || len > MAX_WORD || f->size - f->pos < (size_t) len) return 1;
+        memcpy(x->keys[x->n], f->data + f->pos, len);
+        x->keys[x->n][len] = '\0';
+        f->pos += len;
+    }
+    return 0;
 }
 
-// scambia un nodo con un suo figlio mantenendo le proprietà dei BST (dir = 0 se rotazione sinistra, 1 se rotazione destra)
-static void rotate(NODO *f, int dir)
+// lettura a bit: i byte del file passano dalla memoria in un intero a 64 bit, da cui ogni tabella legge i suoi bit con
+// un solo shift
+typedef struct
 {
-    NODO *c, *s;
+    unsigned long long acc; // bit non ancora consumati, allineati a sinistra
+    int count;              // numero di bit validi in acc
+    unsigned char *data;
+    size_t pos, size;
+} BitReader;
+
+// porta in acc più bit possibile (almeno 57, a meno che il file non sia finito)
+static void refillBits(BitReader *r)
+{
+    while(r->count <= 56 && r->pos < r->size)
+    {
+        r->acc |= (unsigned long long) r->data[r->pos++] << (56 - r->count);
+        r->count += 8;
+    }
+}
 
-    c = f->children[!dir]; // c (child) = figlio destro o sinistro di f (father)
-    s = c->children[dir]; // s (subTree) = figlio sinistro o destro di c
+// inizia a leggere dalla posizione pos del file
+static void startBits(BitReader *r, MappedFile *f, size_t pos)
+{
+    r->acc = 0;
+    r->count = 0;
+    r->data = f->data;
+    r->pos = (pos < f->size) ? pos : f->size;
+    r->size = f->size;
+}
 
-    // s diventa figlio destro di f
-    f->children[!dir] = s;
-    s->father = f;
+// scarta i bit che completano il byte corrente: il blocco successivo inizia dal byte dopo
+static void skipPadding(BitReader *r)
+{
+    r->acc <<= r->count % BITSEQUENCE_LENGTH;
+    r->count -= r->count % BITSEQUENCE_LENGTH;
+}
 
-    // c diventa figlio (sinistro o destro) del padre di f (prima nonno di c)
-    c->father = f->father;
-    f->father->children[!isLeftChild(f)] = c;
+// ritorna la prossima lettera, oppure -1 se i bit rimasti non contengono un codice valido (file terminato o corrotto)
+static int decodeChar(HuffTable *t, BitReader *r)
+{
+    HuffEntry *e;
+    int start;
 
-    // f diventa figlio sinistro o destro di c
-    f->father = c;
-    c->children[dir] = f;
+    for(start = 0; ; start = e->value)
+    {
+        if(r->count < HUFF_TABLE_BITS)
+            refillBits(r);
 
-    // cambio il numero di nodi nei sottoalberi radicati in c e f
-    c->nodes = f->nodes;
-    f->nodes -= (1 + c->children[!dir]->nodes);
+        // oltre la fine del file acc contiene degli 0, quindi un codice più lungo dei bit rimasti non è valido
+        e = &t->v[start + (int) (r->acc >> (64 - HUFF_TABLE_BITS))];
+        if(e->len == 0 || e->len > r->count) return -1;
+
+        r->acc <<= e->len;
+        r->count -= e->len;
+        if(!e->sub) return e->value;
+    }
 }
 
-// inserisce un nodo in fondo al RBT con colore rosso
-static void insertNode(NODO *root, NODO *node)
+// legge la prossima voce "word[def]": la parola (troncata a MAX_WORD + 1 caratteri, tanto una più lunga non è valida)
+// va in w[] e la definizione in *d, che viene ingrandito quando serve
+// ritorna 1 se ha letto una voce, 0 se ha trovato il terminatore e -1 se i dati non sono validi o manca memoria
+static int readEntry(HuffTable *t, BitReader *r, char w[], char **d, size_t *size)
 {
-    int pos;
+    char *temp;
+    int c, i, readWord;
+
+    readWord = 1;
+    i = 0;
+    while((c = decodeChar(t, r)) >= 0)
+    {
+        if(c == TERMINATOR && readWord && i == 0)
+            return 0;
+        else if(c == '[' && readWord) // quando trovo una '[' termino la parola e mi preparo a leggere la definizione
+        {
+            readWord = 0;
+            w[i] = '\0';
+            i = 0;
+        }
+        else if(c == ']' && !readWord) // quando trovo una ']' la voce è completa
+        {
+            (*d)[i] = '\0';
+            return 1;
+        }
+        else if(readWord)
+        {
+            if(i <= MAX_WORD)
+                w[i++] = c;
+        }
+        else
+        {
+            if(i + 1 == (int) *size)
+            {
+                temp = (char *) realloc(*d, *size * 2);
+                if(temp == NULL) return -1;
+                *d = temp;
+                *size *= 2;
+            }
+            (*d)[i++] = c;
+        }
+    }
+    return -1;
+}
+
+/// FUNZIONI STATICHE PER RED-BLACK TREES
+
+// intestazione dei blocchi di memoria ottenuti con malloc per le stringhe (gruppi di stringhe corte o stringhe lunghe)
+typedef struct _TextBlock
+{
+    struct _TextBlock *prev, *next;
+} TextBlock;
+
+// pool da cui vengono allocate le stringhe di un dizionario: quelle corte occupano posti di dimensione multipla di
+// TEXT_CLASS presi da blocchi di TEXT_CHUNK byte (i posti liberati sono riutilizzati da stringhe della stessa classe),
+// quelle più lunghe di TEXT_SMALL byte hanno un blocco ciascuna
+typedef struct
+{
+    TextBlock *blocks;                          // tutti i blocchi allocati, liberati insieme al dizionario
+    char *next;                                 // inizio dello spazio ancora libero nel blocco corrente
+    size_t left;                                // byte ancora liberi nel blocco corrente
+    char *freeLists[TEXT_SMALL / TEXT_CLASS];   // posti liberi di ogni classe, collegati tramite i loro primi byte
+} TextPool;
 
-    // se il valore del nodo da inserire è superiore a quello esaminato scendo nel sottoalbero destro (1 = true)
-    pos = strcmp(node->word, root->word) > 0;
+// definizione predefinita, condivisa da tutti i nodi che non ne hanno una
+static char nullDef[] = "(null)";
 
-    // se mi trovo in una foglia inserisco il nodo, altrimenti ripeto il procedimento nel sottoalbero sinistro
-    if(strcmp(root->children[pos]->word, SENTINEL) == 0)
+// alloca un blocco di size byte e lo aggiunge alla lista dei blocchi del pool, ritornando lo spazio dopo l'intestazione
+static char* textBlock(TextPool *p, size_t size)
+{
+    TextBlock *b;
+
+    b = (TextBlock *) malloc(sizeof(TextBlock) + size);
+    if(b == NULL) return NULL;
+
+    b->prev = NULL;
+    b->next = p->blocks;
+    if(p->blocks != NULL)
+        p->blocks->prev = b;
+    p->blocks = b;
+    return (char *) (b + 1);
+}
+
+// copia nel pool i len caratteri di s (che non serve sia terminata) e ritorna la copia, terminata, oppure NULL in caso
+// di errori di allocazione
+static char* textAlloc(TextPool *p, char *s, size_t len)
+{
+    size_t size;
+    char *t;
+    int c;
+
+    if(len + 1 > TEXT_SMALL)
     {
-        root->children[pos] = node;
-        node->father = root;
+        t = textBlock(p, len + 1);
+        if(t == NULL) return NULL;
     }
     else
-        insertNode(root->children[pos], node);
+    {
+        // c è la classe della stringa, cioè quella dei posti da (c+1)*TEXT_CLASS byte
+        c = (int) (len / TEXT_CLASS);
+        if(p->freeLists[c] != NULL)
+        {
+            t = p->freeLists[c];
+            p->freeLists[c] = *(char **) t;
+        }
+        else
+        {
+            // se il blocco corrente non ha abbastanza spazio ne inizio uno nuovo (lo spazio rimasto va perso)
+            size = (c + 1) * TEXT_CLASS;
+            if(p->left < size)
+            {
+                p->next = textBlock(p, TEXT_CHUNK);
+                if(p->next == NULL)
+                {
+                    p->left = 0;
+                    return NULL;
+                }
+                p->left = TEXT_CHUNK;
+            }
+            t = p->next;
+            p->next += size;
+            p->left -= size;
+        }
+    }
 
-    // avendo inserito il nodo aumento il contatore dei nodi (tranne che nella sentinella)
-    if(strcmp(root->word, SENTINEL) != 0)
-        root->nodes++;
+    memcpy(t, s, len);
+    t[len] = '\0';
+    return t;
 }
 
-// distribuisce il colore rosso sull'albero in seguito a un inserimento
-static void distributeRed(NODO *node)
+// restituisce al pool la memoria della stringa t
+static void textFree(TextPool *p, char *t)
 {
-    NODO *father, *grandfather, *uncle, *temp;
+    TextBlock *b;
+    size_t len;
+    int c;
+
+    len = strlen(t);
+    if(len + 1 > TEXT_SMALL)
+    {
+        // le stringhe lunghe hanno un blocco proprio, che tolgo dalla lista e libero
+        b = (TextBlock *) t - 1;
+        if(b->prev != NULL)
+            b->prev->next = b->next;
+        else
+            p->blocks = b->next;
+        if(b->next != NULL)
+            b->next->prev = b->prev;
+        free(b);
+    }
+    else
+    {
+        c = (int) (len / TEXT_CLASS);
+        *(char **) t = p->freeLists[c];
+        p->freeLists[c] = t;
+    }
+}
 
-    father = node->father;
+// libera tutti i blocchi del pool
+static void textDestroy(TextPool *p)
+{
+    TextBlock *b, *next;
 
-    // CASO 1: se il nodo è alla radice lo coloro di nero (la radice ha come padre la sentinella)
-    if(strcmp(father->word, SENTINEL) == 0)
+    for(b = p->blocks; b != NULL; b = next)
     {
-        node->color = BLACK;
-        return;
+        next = b->next;
+        free(b);
     }
+}
+
+// sposta in fondo alla lista dei blocchi di p quelli di q (lo spazio libero di q non viene più usato)
+static void textMerge(TextPool *p, TextPool *q)
+{
+    TextBlock *b;
 
-    // CASO 2: se il nodo ha un padre nero allora l'albero è un RBT
-    if(father->color == BLACK)
+    if(q->blocks == NULL) return;
+    if(p->blocks == NULL)
+    {
+        p->blocks = q->blocks;
         return;
+    }
+    for(b = p->blocks; b->next != NULL; b = b->next);
+    b->next = q->blocks;
+    q->blocks->prev = b;
+}
+
+// posto dell'indice hash: nodo della parola (NULL se il posto è libero) e valore hash della parola
+typedef struct
+{
+    unsigned int hash;
+    NODO *node;
+} HashEntry;
+
+// indice hash a indirizzamento aperto con scansione lineare e politica Robin Hood: una parola si sposta davanti a quelle
+// più vicine alla propria posizione ideale, quindi le ricerche senza successo si fermano presto
+typedef struct
+{
+    HashEntry *table;   // NULL se l'indice non è attivo
+    unsigned int mask;  // dimensione della tabella (potenza di 2) meno 1
+    unsigned int count; // parole nell'indice
+} HashIndex;
+
+// valore hash FNV-1a della parola
+static unsigned int hashWord(char *w)
+{
+    unsigned int h;
+
+    h = 2166136261u;
+    for(; *w != '\0'; w++)
+        h = (h ^ (unsigned char) *w) * 16777619u;
+    return h;
+}
+
+// distanza di un posto occupato dalla posizione ideale del suo valore hash
+#define probeDistance(h, e, pos) (((pos) - ((e)->hash & (h)->mask)) & (h)->mask)
 
-    grandfather = father->father;
-    uncle = grandfather->children[isLeftChild(father)];
-    // CASO 3: se lo zio esiste ed è rosso sposto la colorazione sul nonno e coloro di nero loro due
-    if(uncle->color == RED)
+// ritorna il nodo della parola w con valore hash indicato (NULL se assente)
+static NODO* hashFind(HashIndex *h, char *w, unsigned int hash)
+{
+    HashEntry *e;
+    unsigned int pos, dist;
+
+    // quando trovo un posto libero o più vicino alla sua posizione ideale di quanto lo sarebbe w la parola non c'è
+    pos = hash & h->mask;
+    for(dist = 0; ; dist++)
     {
-        father->color = BLACK;
-        uncle->color = BLACK;
-        grandfather->color = RED;
+        e = &h->table[pos];
+        if(e->node == NULL || probeDistance(h, e, pos) < dist) return NULL;
+        if(e->hash == hash && strcmp(e->node->word, w) == 0) return e->node;
+        pos = (pos + 1) & h->mask;
+    }
+}
 
-        distributeRed(grandfather); // itero sul nonno
-        return;
+// inserisce nella tabella un nodo non presente, senza controllarne la dimensione
+static void hashPlace(HashIndex *h, NODO *node, unsigned int hash)
+{
+    HashEntry e, temp;
+    unsigned int pos, dist;
+
+    e.hash = hash;
+    e.node = node;
+    pos = hash & h->mask;
+    for(dist = 0; h->table[pos].node != NULL; dist++)
+    {
+        // se il posto è occupato da una parola più vicina alla sua posizione ideale la sposto in avanti al posto di e
+        if(probeDistance(h, &h->table[pos], pos) < dist)
+        {
+            temp = h->table[pos];
+            h->table[pos] = e;
+            e = temp;
+            dist = probeDistance(h, &e, pos);
+        }
+        pos = (pos + 1) & h->mask;
     }
+    h->table[pos] = e;
+    h->count++;
+}
 
-    // CASO 4: se il nodo, il padre e il nonno non sono disposti lungo una retta (quindi il nodo è figlio sinistro e il padre
-    // è figlio destro o viceversa) effettuo una rotazione sul padre per fare in modo che lo diventino
-    if(isLeftChild(node) != isLeftChild(father))
+// alloca una tabella vuota con size posti (potenza di 2), ritorna 1 in caso di errori di allocazione
+static int hashAlloc(HashIndex *h, unsigned int size)
+{
+    h->table = (HashEntry *) calloc(size, sizeof(HashEntry));
+    if(h->table == NULL) return 1;
+
+    h->mask = size - 1;
+    h->count = 0;
+    return 0;
+}
+
+// libera la memoria dell'indice, che risulta disattivato
+static void hashDestroy(HashIndex *h)
+{
+    free(h->table);
+    h->table = NULL;
+}
+
+// inserisce un nodo nell'indice raddoppiando la tabella quando è piena per 7/8
+// se non c'è memoria per la nuova tabella l'indice viene disattivato e le ricerche tornano a usare l'albero
+static void hashInsert(HashIndex *h, NODO *node)
+{
+    HashIndex old;
+    unsigned int i;
+
+    if((h->count + 1) * 8 > (h->mask + 1) * 7)
     {
-        // ruoto a destra se node è figlio sinistro o viceversa
-        rotate(father, isLeftChild(node));
+        old = *h;
+        if(hashAlloc(h, (old.mask + 1) * 2) != 0)
+        {
+            hashDestroy(&old);
+            return;
+        }
+        for(i = 0; i <= old.mask; i++)
+            if(old.table[i].node != NULL)
+                hashPlace(h, old.table[i].node, old.table[i].hash);
+        hashDestroy(&old);
+    }
+    hashPlace(h, node, hashWord(node->word));
+}
+
+// toglie un nodo dall'indice, spostando indietro di un posto le parole successive che non sono nella posizione ideale
+static void hashRemove(HashIndex *h, NODO *node)
+{
+    unsigned int pos, next;
+
+    pos = hashWord(node->word) & h->mask;
+    while(h->table[pos].node != node)
+        pos = (pos + 1) & h->mask;
+
+    next = (pos + 1) & h->mask;
+    while(h->table[next].node != NULL && probeDistance(h, &h->table[next], next) > 0)
+    {
+        h->table[pos] = h->table[next];
+        pos = next;
+        next = (next + 1) & h->mask;
+    }
+    h->table[pos].node = NULL;
+    h->count--;
+}
+
+// crea un indice con una tabella adatta a n parole, ritorna 1 in caso di errori di allocazione
+static int hashCreate(HashIndex *h, int n)
+{
+    unsigned int size;
+
+    for(size = HASH_SIZE; size * 7 < (unsigned int) n * 8; size *= 2);
+    return hashAlloc(h, size);
+}
+
+// nodo dell'indice metrico (BK-tree): i figli sono collegati in lista e ognuno ha da esso una distanza DL_metric
+// diversa, uguale a quella di tutte le parole nel suo sottoalbero
+typedef struct
+{
+    char word[MAX_WORD + 1];    // copia della parola, che resta come nodo di passaggio anche quando viene cancellata
+    NODO *node;                 // nodo del dizionario con la parola, NULL se è stata cancellata
+    int dist;                   // distanza dal padre
+    int child;                  // primo figlio (-1 se non ce ne sono)
+    int sibling;                // fratello successivo (-1 se è l'ultimo)
+} BKNode;
+
+// indice metrico facoltativo per la ricerca avanzata, con i nodi in un vettore di cui v[0] è la radice
+typedef struct
+{
+    BKNode *v;  // NULL se l'indice non è attivo
+    int n;      // nodi usati
+    int size;   // nodi allocati
+    int dead;   // nodi di parole cancellate
+} BKTree;
+
+// libera la memoria dell'indice metrico, che risulta disattivato
+static void bkDestroy(BKTree *t)
+{
+    free(t->v);
+    t->v = NULL;
+    t->n = 0;
+    t->size = 0;
+    t->dead = 0;
+}
+
+// aggiunge la parola del nodo all'indice (o la riattiva se era stata cancellata), ritorna 1 in caso di errori
+static int bkInsert(BKTree *t, NODO *node)
+{
+    BKNode *v;
+    int cur, next, dist;
+
+    // scendo seguendo a ogni passo il figlio che ha dal nodo corrente la stessa distanza della parola
+    cur = -1;
+    dist = 0;
+    if(t->n > 0)
+    {
+        for(cur = 0; ; cur = next)
+        {
+            dist = DL_metric(node->word, t->v[cur].word);
+            if(dist == 0)
+            {
+                if(t->v[cur].node == NULL)
+                    t->dead--;
+                t->v[cur].node = node;
+                return 0;
+            }
+
+            for(next = t->v[cur].child; next != -1 && t->v[next].dist != dist; next = t->v[next].sibling);
+            if(next == -1) break;
+        }
+    }
+
+    if(t->n == t->size)
+    {
+        v = (BKNode *) realloc(t->v, (t->size > 0 ? 2 * t->size : POOL_CHUNK) * sizeof(BKNode));
+        if(v == NULL) return 1;
+        t->v = v;
+        t->size = (t->size > 0) ? 2 * t->size : POOL_CHUNK;
+    }
+
+    // il nuovo nodo diventa il primo figlio dell'ultimo nodo visitato
+    v = &t->v[t->n];
+    strcpy_s(v->word, MAX_WORD + 1, node->word);
+    v->node = node;
+    v->dist = dist;
+    v->child = -1;
+    v->sibling = -1;
+    if(cur != -1)
+    {
+        v->sibling = t->v[cur].child;
+        t->v[cur].child = t->n;
+    }
+    t->n++;
+    return 0;
+}
+
+// segna come cancellata la parola del nodo, che resta nell'indice per non dover spostare il suo sottoalbero
+static void bkRemove(BKTree *t, NODO *node)
+{
+    int cur, dist;
+
+    for(cur = 0; cur != -1; )
+    {
+        dist = DL_metric(node->word, t->v[cur].word);
+        if(dist == 0)
+        {
+            t->v[cur].node = NULL;
+            t->dead++;
+            return;
+        }
+        for(cur = t->v[cur].child; cur != -1 && t->v[cur].dist != dist; cur = t->v[cur].sibling);
+    }
+}
+
+// raccoglie le parole che possono stare fra le tre più simili a w, ritorna 1 in caso di errori di allocazione
+static int bkSearch(BKTree *t, char *w, DLPattern *p, CandidateList *c)
+{
+    int *stack, top, cur, next, dist;
+
+    candidateInit(c);
+    if(t->n == 0) return 0;
+
+    // ogni nodo entra nella pila al più una volta
+    stack = (int *) malloc(t->n * sizeof(int));
+    if(stack == NULL) return 1;
+
+    stack[0] = 0;
+    top = 1;
+    while(top > 0)
+    {
+        cur = stack[--top];
+        dist = DL_metric(w, t->v[cur].word);
+
+        // DL_metric non supera DL_distance, quindi calcolo quest'ultima solo se la parola può ancora essere fra le più simili
+        if(t->v[cur].node != NULL && dist <= c->best[0]
+           && candidateAdd(c, t->v[cur].node, DL_distance(p, t->v[cur].word, c->best[0])) != 0)
+        {
+            free(stack);
+            free(c->v);
+            return 1;
+        }
+
+        // per la disuguaglianza triangolare le parole sotto il figlio a distanza e distano da w almeno |dist - e|
+        for(next = t->v[cur].child; next != -1; next = t->v[next].sibling)
+            if(abs(t->v[next].dist - dist) <= c->best[0])
+                stack[top++] = next;
+    }
+
+    free(stack);
+    return 0;
+}
+
+// parole del dizionario divise per lunghezza, ognuna nell'ordine di visita di spellCheck: la ricerca avanzata lo
+// ricostruisce quando l'albero è cambiato e legge solo le lunghezze abbastanza vicine a quella della parola cercata
+typedef struct
+{
+    NODO **v;
+    int size;                   // posti allocati in v
+    int start[MAX_WORD + 2];    // le parole lunghe l occupano le posizioni da start[l] a start[l+1] - 1
+    int valid;                  // 0 se le parole sono cambiate dall'ultima costruzione
+} LengthIndex;
+
+// raccoglie i candidati leggendo prima le parole con la stessa lunghezza di quella cercata, poi quelle che differiscono
+// di 1, 2, ... finché la differenza non supera la distanza della terza parola più simile
+static void lengthSpellCheck(LengthIndex *x, SpellState *s)
+{
+    int i, l, delta, side;
+
+    for(delta = 0; delta <= MAX_WORD && delta <= spellCutoff(s); delta++)
+        for(side = -1; side <= 1; side += 2)
+        {
+            l = s->pattern->len + side * delta;
+            if(l < 0 || l > MAX_WORD || (delta == 0 && side > 0)) continue;
+
+            for(i = x->start[l]; i < x->start[l + 1] && delta <= spellCutoff(s); i++)
+                spellVisit(s, x->v[i]);
+        }
+}
+
+// blocco di nodi ottenuto con un'unica chiamata a malloc
+typedef struct _NodeChunk
+{
+    struct _NodeChunk *next;
+    NODO nodes[POOL_CHUNK];
+} NodeChunk;
+
+// log delle modifiche di un dizionario aperto con openDictionary
+typedef struct _Journal Journal;
+
+// pool da cui vengono allocati i nodi di un dizionario: la sentinella è il primo campo, perciò il puntatore al dizionario
+// coincide con quello del suo pool
+typedef struct
+{
+    NODO sentinel;
+    NodeChunk *chunks;  // lista dei blocchi allocati, il primo è quello da cui si stanno prendendo i nodi
+    int used;           // numero di nodi già assegnati nel primo blocco
+    NODO *freeList;     // nodi liberati e riutilizzabili, collegati tramite il campo father
+    TextPool words;     // parole, separate dalle definizioni in modo che la discesa legga memoria più compatta
+    TextPool defs;      // definizioni diverse da quella predefinita
+    HashIndex index;    // indice hash facoltativo per le ricerche esatte
+    BKTree spell;       // indice metrico facoltativo per la ricerca avanzata
+    LengthIndex lengths; // parole divise per lunghezza per la ricerca avanzata
+    int spellThreads;   // thread usati dalla ricerca avanzata senza indice metrico
+    Journal *log;       // log in cui vengono scritte le modifiche (NULL se il dizionario non ne ha uno)
+} NodePool;
+
+#define pool(root) ((NodePool *) (root))
+
+// copia la definizione di len caratteri nel pool (quella predefinita non viene copiata) e la ritorna, NULL in caso di
+// errori
+static char* defAlloc(NODO *root, char *def, size_t len)
+{
+    if(len == sizeof(nullDef) - 1 && memcmp(def, nullDef, len) == 0) return nullDef;
+
+    return textAlloc(&pool(root)->defs, def, len);
+}
+
+// restituisce al pool la memoria di una definizione
+static void defFree(NODO *root, char *def)
+{
+    if(def != nullDef)
+        textFree(&pool(root)->defs, def);
+}
+
+// alloca un nuovo nodo con valori predefiniti prendendolo dal pool del dizionario (root è la sentinella)
+static NODO* nodeAlloc(NODO *root, char *w, char *def, size_t defLen)
+{
+    NodePool *p;
+    NodeChunk *chunk;
+    NODO *node;
+    char *word, *d;
+
+    p = pool(root);
+
+    // copio la parola e la definizione nei rispettivi pool
+    word = textAlloc(&p->words, w, strlen(w));
+    if(word == NULL) return NULL;
+    d = defAlloc(root, def, defLen);
+    if(d == NULL)
+    {
+        textFree(&p->words, word);
+        return NULL;
+    }
+
+    // riutilizzo per primi i nodi liberati, altrimenti prendo il successivo del blocco corrente (se è pieno ne alloco uno)
+    if(p->freeList != NULL)
+    {
+        node = p->freeList;
+        p->freeList = node->father;
+    }
+    else
+    {
+        if(p->used == POOL_CHUNK)
+        {
+            chunk = (NodeChunk *) malloc(sizeof(NodeChunk));
+            if(chunk == NULL)
+            {
+                textFree(&p->words, word);
+                defFree(root, d);
+                return NULL;
+            }
+
+            chunk->next = p->chunks;
+            p->chunks = chunk;
+            p->used = 0;
+        }
+        node = &p->chunks->nodes[p->used++];
+    }
+
+    node->word = word;
+    node->def = d;
+    node->father = NULL;
+    node->children[LEFT] = root; // le foglie puntano alla sentinella, in questo modo si ha una struttura circolare
+    node->children[RIGHT] = root; // e non sono necessari i controlli su NULL
+    node->color = RED;   // i nodi inseriti hanno inizialmente colore rosso
+    node->nodes = 1;    // inizialmente nel sottoalbero radicato in node c'è solo esso stesso
+    return node;
+}
+
+// restituisce un nodo al pool del dizionario in modo che possa essere riutilizzato (le sue stringhe sono liberate a parte)
+static void nodeFree(NODO *root, NODO *node)
+{
+    node->father = pool(root)->freeList;
+    pool(root)->freeList = node;
+}
+
+// inizializza un nuovo RBT
+static NODO* init()
+{
+    NodePool *p;
+    NODO *n;
+
+    p = (NodePool *) malloc(sizeof(NodePool));
+    if(p == NULL) return NULL;
+
+    memset(p, 0, sizeof(NodePool));    // i pool di stringhe partono senza blocchi e con le liste dei posti liberi vuote
+    p->chunks = NULL;
+    p->used = POOL_CHUNK;  // in questo modo il primo nodo allocato crea il primo blocco
+    p->freeList = NULL;
+    p->spellThreads = 1;
+
+    // inizializzo una sentinella di colore nero con valore SENTINEL (ha se stessa come figli e conta sempre 0 nodi)
+    n = &p->sentinel;
+    n->word = SENTINEL;
+    n->def = SENTINEL;
+    n->father = NULL;
+    n->children[0] = n;
+    n->children[1] = n;
+    n->nodes = 0;
+    n->color = BLACK;
+    return n;
+}
+
+// sposta nel pool del dizionario i blocchi di nodi e di stringhe di quello di part, che viene liberato: i nodi di part
+// possono poi far parte del dizionario (part deve essere senza indici)
+static void poolMerge(NODO *root, NODO *part)
+{
+    NodeChunk **chunk;
+
+    for(chunk = &pool(root)->chunks; *chunk != NULL; chunk = &(*chunk)->next);
+    *chunk = pool(part)->chunks;
+    textMerge(&pool(root)->words, &pool(part)->words);
+    textMerge(&pool(root)->defs, &pool(part)->defs);
+    free(pool(part));
+}
+
+// presa in input la sentinella, ritorna la testa del RBT
+static NODO *head(NODO *root)
+{
+    return root->children[RIGHT]; // poiché la sentinella ha valore "" (0) tutti i suoi figli sono a destra
+}
+
+// scambia un nodo con un suo figlio mantenendo le proprietà dei BST (dir = 0 se rotazione sinistra, 1 se rotazione destra)
+static void rotate(NODO *f, int dir)
+{
+    NODO *c, *s;
+
+    c = f->children[!dir]; // c (child) = figlio destro o sinistro di f (father)
+    s = c->children[dir]; // s (subTree) = figlio sinistro o destro di c
+
+    // s diventa figlio destro di f
+    f->children[!dir] = s;
+    s->father = f;
+
+    // c diventa figlio (sinistro o destro) del padre di f (prima nonno di c)
+    c->father = f->father;
+    f->father->children[!isLeftChild(f)] = c;
+
+    // f diventa figlio sinistro o destro di c
+    f->father = c;
+    c->children[dir] = f;
+
+    // cambio il numero di nodi nei sottoalberi radicati in c e f
+    c->nodes = f->nodes;
+    f->nodes -= (1 + c->children[!dir]->nodes);
+}
+
+// annulla l'incremento del contatore dei nodi fatto su node e sui suoi avi durante una discesa
+static void undoCount(NODO *root, NODO *node)
+{
+    for(; node != root; node = node->father)
+        node->nodes--;
+}
+
+// inserisce in fondo al RBT un nuovo nodo rosso con la parola (già normalizzata) e la definizione indicate, cercando
+// duplicati e posizione con un'unica discesa in cui aumenta il contatore dei nodi incontrati; ritorna il nuovo nodo
+// oppure NULL se la parola è già presente o in caso di errori di allocazione
+static NODO* insertNode(NODO *root, char *w, char *def)
+{
+    NODO *father, *node;
+    int cmp, pos;
+
+    // la radice è il figlio destro della sentinella
+    father = root;
+    pos = RIGHT;
+    node = head(root);
+    while(node != root)
+    {
+        // se la parola è già presente annullo gli incrementi fatti sugli avi del nodo trovato
+        cmp = strcmp(w, node->word);
+        if(cmp == 0)
+        {
+            undoCount(root, node->father);
+            return NULL;
+        }
+
+        // se il valore da inserire è superiore a quello esaminato scendo nel sottoalbero destro (1 = true)
+        node->nodes++;
+        father = node;
+        pos = cmp > 0;
+        node = node->children[pos];
+    }
+
+    // arrivato in una foglia alloco il nodo e lo collego al padre
+    node = nodeAlloc(root, w, def, strlen(def));
+    if(node == NULL)
+    {
+        undoCount(root, father);
+        return NULL;
+    }
+    father->children[pos] = node;
+    node->father = father;
+    return node;
+}
+
+// distribuisce il colore rosso sull'albero in seguito a un inserimento
+static void distributeRed(NODO *root, NODO *node)
+{
+    NODO *father, *grandfather, *uncle, *temp;
+
+    // ripeto finché il CASO 3 sposta il problema sul nonno
+    while(1)
+    {
+        father = node->father;
+
+        // CASO 1: se il nodo è alla radice lo coloro di nero (la radice ha come padre la sentinella)
+        if(father == root)
+        {
+            node->color = BLACK;
+            return;
+        }
+
+        // CASO 2: se il nodo ha un padre nero allora l'albero è un RBT
+        if(father->color == BLACK)
+            return;
+
+        grandfather = father->father;
+        uncle = grandfather->children[isLeftChild(father)];
+        // CASO 3: se lo zio esiste ed è rosso sposto la colorazione sul nonno e coloro di nero loro due
+        if(uncle->color != RED)
+            break;
+
+        father->color = BLACK;
+        uncle->color = BLACK;
+        grandfather->color = RED;
+        node = grandfather; // itero sul nonno
+    }
+
+    // CASO 4: se il nodo, il padre e il nonno non sono disposti lungo una retta (quindi il nodo è figlio sinistro e il padre
+    // è figlio destro o viceversa) effettuo una rotazione sul padre per fare in modo che lo diventino
+    if(isLeftChild(node) != isLeftChild(father))
+    {
+        // ruoto a destra se node è figlio sinistro o viceversa
+        rotate(father, isLeftChild(node));
+
+        // ora nodo e padre sono scambiati, perciò devo cambiare le variabili temporanee che puntano ad essi
+        temp = node;
+        node = father;
+        father = temp;
+    }
+
+    // posso ruotare intorno al nonno in modo che il padre si sposti in cima e scambio le colorazioni del padre e del nonno
+    grandfather->color = RED;
+    father->color = BLACK;
+    rotate(grandfather, isLeftChild(father)); // ruoto a destra se il padre è figlio sinistro o viceversa
+}
+
+// rimuove un nodo dal RBT ma senza controllare che le proprietà siano preservate e ritorna un nodo adiacente al nodo rimosso
+static NODO* deleteNode(NODO *root, NODO* node)
+{
+    NODO *temp, *child, *father;
+    int isRedNode;
+
+    // la parola e la definizione da eliminare sono quelle del nodo indicato
+    textFree(&pool(root)->words, node->word);
+    defFree(root, node->def);
+
+    // avendo trovato il nodo, dato che devo rimuoverlo, decremento il valore dei nodi di tutti i suoi avi e anche di se
+    // stesso perché potrei dover spostare il suo successore al suo posto
+    temp = node;
+    while(temp != root)
+    {
+        temp->nodes--;
+        temp = temp->father;
+    }
+
+    // se il nodo ha entrambi i figli tolgo dalla sua posizione il successore, che poi prenderà il posto del nodo
+    // nel cercare il successore diminuisco di uno il campo nodes di tutti i nodi incontrati
+    temp = node;
+    if(node->nodes > 1)
+    {
+        // il successore è il nodo più a sinistra del sottoalbero destro
+        temp = node->children[RIGHT];
+        while(temp->children[LEFT] != root)
+        {
+            temp->nodes--;
+            temp = temp->children[LEFT];
+        }
+    }
+
+    // collego il padre del nodo tolto al suo eventuale unico figlio (destro o sinistro)
+    father = temp->father;
+    child = temp->children[temp->children[LEFT] == root];
+    child->father = father;
+    father->children[!isLeftChild(temp)] = child;
+    isRedNode = (temp->color == RED);
+
+    // il successore sostituisce il nodo nell'albero con il suo colore e il suo numero di nodi: in questo modo ogni parola
+    // resta sempre nello stesso nodo (se il figlio era la sentinella sotto al nodo, ora ha il successore come padre)
+    if(temp != node)
+    {
+        temp->father = node->father;
+        node->father->children[!isLeftChild(node)] = temp;
+        temp->children[LEFT] = node->children[LEFT];
+        temp->children[LEFT]->father = temp;
+        temp->children[RIGHT] = node->children[RIGHT];
+        temp->children[RIGHT]->father = temp;
+        temp->color = node->color;
+        temp->nodes = node->nodes;
+    }
+
+    // infine dealloco il nodo: se quello tolto era rosso ritorno NULL altrimenti ritorno il figlio che ha preso il suo posto
+    // (nel caso fosse la sentinella avrà comunque il padre del nodo tolto come suo padre)
+    nodeFree(root, node);
+    return isRedNode ? NULL : child;
+}
+
+// distribuisce il doppio nero sull'albero in seguito a un'eliminazione
+static void distributeDoubleBlack(NODO *root, NODO *node)
+{
+    NODO *father, *sibling;
+
+    // ripeto finché il CASO 2 sposta il doppio nero sul padre
+    while(1)
+    {
+        father = node->father;
+        sibling = father->children[isLeftChild(node)];
+
+        // se il nodo è rosso o è alla radice (il padre è la sentinella) coloro il nodo di nero
+        if(node->color == RED || father == root)
+        {
+            node->color = BLACK;
+            return;
+        }
+
+        // CASO 1: il fratello è rosso (quindi entrambi i figli sono neri come anche il padre)
+        // mi basta ruotare intorno al padre e al fratello scambiando i loro colori per rientrare in uno dei casi successivi
+        if(sibling->color == RED)
+        {
+            sibling->color = BLACK;
+            father->color = RED;
+            rotate(father, isLeftChild(sibling));
+
+            sibling = father->children[isLeftChild(node)]; // in seguito alle rotazioni cambia il fratello del nodo
+        }
+
+        // CASO 2: il fratello è nero
+        // se ha entrambi i figli neri, posso colorare il fratello di rosso
+        if(sibling->children[LEFT]->color != BLACK || sibling->children[RIGHT]->color != BLACK)
+            break;
+
+        sibling->color = RED;
+        if(father->color == RED)
+        {
+            father->color = BLACK;  // nel caso in cui anche il padre fosse rosso, mi basta colorarlo di nero
+            return;
+        }
+        node = father;  // altrimenti il padre diventa il nodo con doppio nero
+    }
+
+    // se padre e figlio rosso non sono allineati, ruoto intorno ad essi per fare in modo che lo siano
+    // a quel punto scambio i loro colori e imposto l'ex-figlio rosso come fratello perché è salito di un livello
+    if(sibling->children[!isLeftChild(sibling)]->color != RED)
+    {
+        sibling->color = RED;
+        sibling->children[isLeftChild(sibling)]->color = BLACK; // il nodo rosso è quello non allineato
+
+        // se il fratello è figlio sinistro allora il figlio rosso è figlio destro, quindi ruoto verso sinistra
+        rotate(sibling, !isLeftChild(sibling));
+        sibling = sibling->father;  // il nuovo "fratello" da esaminare è il nodo padre di quello corrente
+    }
+
+    // una volta che il figlio rosso del fratello è allineato con esso, coloro di nero il figlio,
+    // poi scambio il colore del padre e del fratello e infine ruoto intorno padre e al fratello
+    sibling->color = father->color;
+    father->color = BLACK;
+    sibling->children[!isLeftChild(sibling)]->color = BLACK;
+
+    // se il fratello è figlio sinistro allora ruoto verso destra, altrimenti verso sinistra
+    rotate(father, isLeftChild(sibling));
+}
+
+// restituisce il nodo con valore cercato (NULL se non è presente) con un solo confronto per livello
+static NODO* nodeSearch(NODO *root, char *w)
+{
+    NODO *node;
+    int cmp;
+
+    // scendo nel sottoalbero sinistro (0 = false) o destro (1 = true) in base al valore dell'elemento cercato finché
+    // non lo trovo o non arrivo alla sentinella
+    node = head(root);
+    while(node != root)
+    {
+        cmp = strcmp(w, node->word);
+        if(cmp == 0) return node;
+        node = node->children[cmp > 0];
+    }
+    return NULL;
+}
+
+// restituisce il nodo con valore cercato usando l'indice hash se è attivo, altrimenti l'albero
+static NODO* findNode(NODO *root, char *w)
+{
+    HashIndex *h;
+
+    h = &pool(root)->index;
+    if(h->table != NULL)
+        return hashFind(h, w, hashWord(w));
+
+    return nodeSearch(root, w);
+}
+
+// inserisce nell'indice hash tutti i nodi del sottoalbero radicato in n
+static void hashTree(HashIndex *h, NODO *root, NODO *n)
+{
+    if(n == root) return;   // caso base
+
+    hashTree(h, root, n->children[LEFT]);
+    hashTree(h, root, n->children[RIGHT]);
+    hashPlace(h, n, hashWord(n->word));
+}
+
+// inserisce nell'indice metrico tutti i nodi del sottoalbero radicato in n, ritorna 1 in caso di errori di allocazione
+static int bkTree(BKTree *t, NODO *root, NODO *n)
+{
+    if(n == root) return 0;
+
+    if(bkInsert(t, n) != 0) return 1;
+    return bkTree(t, root, n->children[LEFT]) || bkTree(t, root, n->children[RIGHT]);
+}
+
+// conta (fill = 0) o salva in postordine (fill = 1) le parole di ogni lunghezza del sottoalbero radicato in n
+static void lengthTree(LengthIndex *x, NODO *root, NODO *n, int fill)
+{
+    int l;
+
+    if(n == root) return;
+
+    lengthTree(x, root, n->children[LEFT], fill);
+    lengthTree(x, root, n->children[RIGHT], fill);
+    l = strlen(n->word);
+    if(fill)
+        x->v[x->start[l]++] = n;
+    else
+        x->start[l + 1]++;
+}
+
+// ricostruisce le liste delle parole per lunghezza se l'albero è cambiato, ritorna 1 in caso di errori di allocazione
+static int lengthBuild(NODO *root)
+{
+    LengthIndex *x;
+    NODO **v;
+    int l;
+
+    x = &pool(root)->lengths;
+    if(x->valid) return 0;
+
+    if(x->size < countWord(root))
+    {
+        v = (NODO **) realloc(x->v, countWord(root) * sizeof(NODO *));
+        if(v == NULL) return 1;
+        x->v = v;
+        x->size = countWord(root);
+    }
+
+    // conto le parole di ogni lunghezza, poi le inserisco a partire dall'inizio della loro lista
+    memset(x->start, 0, sizeof(x->start));
+    lengthTree(x, root, head(root), 0);
+    for(l = 1; l <= MAX_WORD + 1; l++)
+        x->start[l] += x->start[l - 1];
+    lengthTree(x, root, head(root), 1);
+
+    // ogni start[l] si è spostato all'inizio della lista successiva, quindi lo riporto indietro
+    for(l = MAX_WORD + 1; l > 0; l--)
+        x->start[l] = x->start[l - 1];
+    x->start[0] = 0;
+    x->valid = 1;
+    return 0;
+}
+
+// restituisce il nodo in posizione i-esima
+static NODO* nodeAt(NODO *root, int i)
+{
+    NODO *node;
+    int leftNodes;
+
+    // se i = nodi nel sottoalbero sinistro allora, dato che conto partendo da 0, il nodo corrente è l'i-esimo
+    node = head(root);
+    while(i != (leftNodes = node->children[LEFT]->nodes))
+    {
+        // se i < al numero di nodi a sinistra, lo cerco nel sottoalbero sinistro
+        // altrimenti cerco nel sottoalbero destro in posizione i - nodi - 1
+        if(i < leftNodes)
+            node = node->children[LEFT];
+        else
+        {
+            i -= (leftNodes + 1);
+            node = node->children[RIGHT];
+        }
+    }
+    return node;
+}
+
+// ritorna il numero di parole minori di w, cioè la posizione che w ha o avrebbe nel dizionario, e salva in *first il
+// primo nodo con parola maggiore o uguale (la sentinella se non c'è)
+static int nodeRank(NODO *root, char *w, NODO **first)
+{
+    NODO *node;
+    int rank;
+
+    // ogni volta che scendo a destra tutto il sottoalbero sinistro e il nodo corrente precedono w
+    rank = 0;
+    *first = root;
+    node = head(root);
+    while(node != root)
+    {
+        if(strcmp(node->word, w) < 0)
+        {
+            rank += node->children[LEFT]->nodes + 1;
+            node = node->children[RIGHT];
+        }
+        else
+        {
+            *first = node;
+            node = node->children[LEFT];
+        }
+    }
+    return rank;
+}
+
+// ritorna il nodo successivo (dir = RIGHT) o precedente (dir = LEFT) in ordine lessicografico, la sentinella dopo
+// l'ultimo o prima del primo; dalla sentinella si passa al primo o all'ultimo nodo
+static NODO* nodeStep(NODO *root, NODO *node, int dir)
+{
+    if(node == root)
+    {
+        node = head(root);
+        if(node == root) return root; // dizionario vuoto
+        while(node->children[!dir] != root) node = node->children[!dir];
+        return node;
+    }
+
+    // il successore è il minimo del sottoalbero destro, se c'è, altrimenti il primo antenato di cui node sta a sinistra
+    // (simmetricamente per il predecessore)
+    if(node->children[dir] != root)
+    {
+        for(node = node->children[dir]; node->children[!dir] != root; node = node->children[!dir]);
+        return node;
+    }
+    while(node->father != root && node == node->father->children[dir])
+        node = node->father;
+    return node->father;
+}
+
+/// FUNZIONI STATICHE PER DIZIONARIO
+
+// buffer in cui printDictionary e saveDictionary formattano le voci, scritto con un'unica fwrite quando è pieno
+typedef struct
+{
+    FILE *f;
+    char *data;   // NULL se l'allocazione non è riuscita: in quel caso ogni pezzo è scritto direttamente
+    size_t size;
+    size_t used;
+    int error;    // 1 se una scrittura sul file non è andata a buon fine
+} ExportBuffer;
+
+static void exportStart(ExportBuffer *e, FILE *f)
+{
+    e->f = f;
+    e->data = (char *) malloc(EXPORT_BUFFER);
+    e->size = (e->data != NULL) ? EXPORT_BUFFER : 0;
+    e->used = 0;
+    e->error = 0;
+}
+
+static void exportFlush(ExportBuffer *e)
+{
+    if(e->used > 0 && fwrite(e->data, 1, e->used, e->f) != e->used)
+        e->error = 1;
+    e->used = 0;
+}
+
+static void exportWrite(ExportBuffer *e, char *s, size_t len)
+{
+    if(e->used + len > e->size)
+    {
+        exportFlush(e);
+        // i pezzi più grandi del buffer (definizioni molto lunghe) sono scritti direttamente
+        if(len > e->size)
+        {
+            if(fwrite(s, 1, len, e->f) != len)
+                e->error = 1;
+            return;
+        }
+    }
+    memcpy(e->data + e->used, s, len);
+    e->used += len;
+}
+
+// accoda le parole in ordine lessicografico nel formato "parola" : [definizione], scorrendole senza ricorsione
+static void exportEntries(ExportBuffer *e, NODO *root)
+{
+    NODO *node;
+
+    for(node = nodeStep(root, root, RIGHT); node != root; node = nodeStep(root, node, RIGHT))
+    {
+        exportWrite(e, "\"", 1);
+        exportWrite(e, node->word, strlen(node->word));
+        exportWrite(e, "\" : [", 5);
+        exportWrite(e, node->def, strlen(node->def));
+        exportWrite(e, "]\n", 2);
+    }
+}
+
+// svuota e libera il buffer, ritornando 1 se qualche scrittura non è andata a buon fine
+static int exportEnd(ExportBuffer *e)
+{
+    exportFlush(e);
+    free(e->data);
+    return e->error;
+}
+
+// classe di ogni byte nei testi: 0 per i caratteri ignorati, WORD_SEPARATOR per gli spazi che separano le parole e
+// la lettera minuscola corrispondente per i caratteri ammissibili (lettere, trattino e parentesi tonde)
+static const unsigned char wordChars[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, '(', ')', 0, 0, 0, '-', 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// salva in w[] la parola di len caratteri in minuscolo e ne ritorna la lunghezza (-1 se supera MAX_WORD caratteri)
+static int normalizeWord(char *word, size_t len, char w[])
+{
+    size_t i;
+    unsigned char c;
+    int j;
+
+    j = 0;
+    for(i = 0; i < len; i++)
+    {
+        c = wordChars[(unsigned char) word[i]];
+        if(c > WORD_SEPARATOR)
+        {
+            // controllo che la parola non vada in overflow
+            if(j == MAX_WORD) return -1;
+            w[j++] = c;
+        }
+    }
+    w[j] = '\0';
+    return j;
+}
+
+/// FUNZIONI STATICHE PER LA COSTRUZIONE IN BLOCCO DEL DIZIONARIO
+
+// vettore dei nodi letti da file, da cui il RBT viene costruito in tempo lineare una volta ordinati i nodi
+typedef struct
+{
+    NODO **v;
+    int n;          // nodi raccolti
+    int size;       // dimensione del vettore
+} NodeBatch;
+
+// ordina i nodi per parola mantenendo l'ordine di lettura fra parole uguali (merge sort, tmp ha almeno n/2 posti)
+static void sortNodes(NODO **v, NODO **tmp, int n)
+{
+    int i, j, k, mid;
+
+    if(n < 2) return;
+
+    mid = n / 2;
+    sortNodes(v, tmp, mid);
+    sortNodes(v + mid, tmp, n - mid);
+
+    // se le due metà sono già in ordine non serve fonderle
+    if(strcmp(v[mid - 1]->word, v[mid]->word) <= 0) return;
+
+    memcpy(tmp, v, mid * sizeof(NODO *));
+    i = 0;
+    j = mid;
+    k = 0;
+    while(i < mid && j < n)
+    {
+        // a parità di parola prendo quella della prima metà, che è stata letta prima
+        if(strcmp(tmp[i]->word, v[j]->word) <= 0)
+            v[k++] = tmp[i++];
+        else
+            v[k++] = v[j++];
+    }
+    while(i < mid)
+        v[k++] = tmp[i++];
+}
+
+// ordina i nodi raccolti e rimuove i duplicati, tenendo la prima occorrenza letta come farebbe insertWord
+static int compactBatch(NODO *root, NodeBatch *b)
+{
+    NODO **tmp;
+    int i, j;
+
+    // se le parole sono già in ordine strettamente crescente (es. file scritto da saveDictionary) non c'è nulla da fare
+    for(i = 1; i < b->n && strcmp(b->v[i - 1]->word, b->v[i]->word) < 0; i++);
+    if(i >= b->n) return 0;
+
+    tmp = (NODO **) malloc((b->n / 2) * sizeof(NODO *));
+    if(tmp == NULL) return 1;
+    sortNodes(b->v, tmp, b->n);
+    free(tmp);
+
+    j = 0;
+    for(i = 0; i < b->n; i++)
+    {
+        if(j > 0 && strcmp(b->v[j - 1]->word, b->v[i]->word) == 0)
+        {
+            // le stringhe stanno nei pool, quindi le restituisco insieme al nodo
+            textFree(&pool(root)->words, b->v[i]->word);
+            defFree(root, b->v[i]->def);
+            nodeFree(root, b->v[i]);
+        }
+        else
+            b->v[j++] = b->v[i];
+    }
+    b->n = j;
+    return 0;
+}
+
+// aggiunge al vettore un nuovo nodo con la parola w già normalizzata, ritorna 1 solo in caso di errori di allocazione
+static int batchPush(NODO *root, NodeBatch *b, char *w, char *def, size_t defLen)
+{
+    NODO **v;
+
+    // quando il vettore è pieno elimino prima i duplicati e lo ingrandisco solo se è ancora pieno per almeno la metà,
+    // così anche un file con molte ripetizioni occupa memoria proporzionale al numero di parole distinte
+    if(b->n == b->size)
+    {
+        if(compactBatch(root, b) != 0) return 1;
+        if(b->n >= b->size / 2)
+        {
+            v = (NODO **) realloc(b->v, (b->size + POOL_CHUNK) * 2 * sizeof(NODO *));
+            if(v == NULL) return 1;
+            b->v = v;
+            b->size = (b->size + POOL_CHUNK) * 2;
+        }
+    }
+
+    b->v[b->n] = nodeAlloc(root, w, def, defLen);
+    if(b->v[b->n] == NULL) return 1;
+    b->n++;
+    return 0;
+}
+
+// aggiunge al vettore un nuovo nodo (se la parola è ammissibile) e ritorna 1 solo in caso di errori di allocazione;
+// parola e definizione, di wordLen e defLen caratteri, non devono essere terminate
+static int batchAdd(NODO *root, NodeBatch *b, char *word, size_t wordLen, char *def, size_t defLen)
+{
+    char w[MAX_WORD + 1];
+
+    if(normalizeWord(word, wordLen, w) < MIN_WORD) return 0;
+    return batchPush(root, b, w, def, defLen);
+}
+
+// divide il testo in parole separate da spazi e le aggiunge al vettore, normalizzandole mentre le legge con una
+// sola consultazione di wordChars per byte; le parole con più di MAX_WORD caratteri ammissibili vengono scartate
+// senza copiarne il resto
+static int batchText(NODO *root, NodeBatch *b, unsigned char *s, size_t size)
+{
+    unsigned char *end, c;
+    char w[MAX_WORD + 1];
+    int j;
+
+    end = s + size;
+    while(s < end)
+    {
+        while(s < end && wordChars[*s] == WORD_SEPARATOR)
+            s++;
+
+        // j arriva al più a MAX_WORD + 1, che indica una parola troppo lunga
+        j = 0;
+        while(s < end && (c = wordChars[*s]) != WORD_SEPARATOR)
+        {
+            if(c != 0 && j <= MAX_WORD)
+                w[j++] = c;
+            s++;
+        }
+
+        if(j >= MIN_WORD && j <= MAX_WORD)
+        {
+            w[j] = '\0';
+            if(batchPush(root, b, w, nullDef, sizeof(nullDef) - 1) != 0) return 1;
+        }
+    }
+    return 0;
+}
+
+// collega gli n nodi ordinati in un sottoalbero perfettamente bilanciato: sono rossi solo i nodi a profondità redDepth
+static NODO* linkBalanced(NODO *root, NODO **v, int n, int depth, int redDepth, NODO *father)
+{
+    NODO *node;
+    int mid;
+
+    if(n == 0) return root;
+
+    // il nodo centrale è la radice del sottoalbero, a sinistra e a destra restano al più un nodo di differenza
+    mid = n / 2;
+    node = v[mid];
+    node->father = father;
+    node->color = (depth == redDepth) ? RED : BLACK;
+    node->nodes = n;
+    node->children[LEFT] = linkBalanced(root, v, mid, depth + 1, redDepth, node);
+    node->children[RIGHT] = linkBalanced(root, v + mid + 1, n - mid - 1, depth + 1, redDepth, node);
+    return node;
+}
+
+// costruisce il RBT (vuoto) con i nodi raccolti e libera il vettore, ritorna 1 in caso di errori di allocazione
+static int buildBatch(NODO *root, NodeBatch *b)
+{
+    int depth, redDepth;
+
+    if(compactBatch(root, b) != 0)
+    {
+        free(b->v);
+        return 1;
+    }
+
+    // tutte le foglie si trovano a profondità floor(log2(n)) o a quella precedente, quindi colorando di rosso l'ultimo
+    // livello tutti i cammini contengono lo stesso numero di nodi neri (se l'albero è completo sono tutti neri)
+    for(depth = 0; (2 << depth) <= b->n; depth++);
+    redDepth = ((b->n & (b->n + 1)) == 0) ? -1 : depth;
+
+    root->children[RIGHT] = linkBalanced(root, b->v, b->n, 0, redDepth, root);
+
+    free(b->v);
+    return 0;
+}
+
+/// FUNZIONI STATICHE PER ISTANTANEE DI SOLA LETTURA
+
+// istantanea immutabile del dizionario: la discesa legge solo il vettore keys, in cui le parole sono disposte in ordine
+// di visita in ampiezza dell'albero (layout di Eytzinger), perciò i primi livelli condividono poche linee di cache
+// tutti i vettori e le stringhe stanno in un'unica immagine che inizia con un SnapshotHeader e usa posizioni invece
+// di puntatori, quindi è identica in memoria e nei file di snapshotDictionary, che mapDictionary usa senza copiarli
+struct _Frozen
+{
+    int n;
+    unsigned long long *keys;   // primi 8 caratteri di ogni parola, in ordine di Eytzinger (posizioni da 1 a n)
+    int *rank;                  // posizione in ordine lessicografico della parola che si trova in ogni posizione di keys
+    unsigned long long *words;  // posizioni in strings delle parole in ordine lessicografico
+    unsigned long long *defs;   // posizioni in strings delle definizioni nello stesso ordine delle parole
+    int *post;                  // posizioni lessicografiche delle parole nell'ordine di visita di searchAdvance
+    char *strings;
+    struct _SnapshotHeader *header; // inizio dell'immagine
+    void *memory;               // blocco allocato che contiene l'immagine (NULL se l'immagine è un file mappato)
+    MappedFile file;
+};
+
+// intestazione dell'immagine di un'istantanea, seguita da keys, words, defs, rank, post e dalle stringhe
+typedef struct _SnapshotHeader
+{
+    char magic[8];                  // SNAPSHOT_MAGIC
+    unsigned int version;           // SNAPSHOT_VERSION
+    unsigned int endian;            // SNAPSHOT_ENDIAN nell'ordine dei byte di chi ha scritto il file
+    unsigned long long n;           // numero di parole
+    unsigned long long strings;     // byte occupati dalle stringhe
+    unsigned long long checksum;    // somma di controllo di tutto ciò che segue l'intestazione
+    unsigned long long sequence;    // ultimo record del log delle modifiche contenuto nell'istantanea (0 se nessuno)
+    char padding[16];               // l'intestazione occupa 64 byte, così keys resta allineato come l'immagine
+} SnapshotHeader;
+
+#define frozenWord(z, i) ((z)->strings + (z)->words[i])
+#define frozenDef(z, i) ((z)->strings + (z)->defs[i])
+
+// byte dell'immagine di un'istantanea con n parole e strings byte di stringhe
+static size_t frozenSize(size_t n, size_t strings)
+{
+    return sizeof(SnapshotHeader) + (n + 1) * sizeof(unsigned long long) + 2 * n * sizeof(unsigned long long) +
+           (2 * n + 1) * sizeof(int) + strings;
+}
+
+// collega i campi dell'istantanea ai vettori dell'immagine che inizia in image
+static void frozenAttach(FROZEN *z, unsigned char *image)
+{
+    SnapshotHeader *h;
+
+    h = (SnapshotHeader *) image;
+    z->header = h;
+    z->n = (int) h->n;
+    z->keys = (unsigned long long *) (image + sizeof(SnapshotHeader));
+    z->words = z->keys + z->n + 1;
+    z->defs = z->words + z->n;
+    z->rank = (int *) (z->defs + z->n);
+    z->post = z->rank + z->n + 1;
+    z->strings = (char *) (z->post + z->n);
+}
+
+// somma di controllo dei size byte di data, letti a gruppi di 8 (gli ultimi completati con zeri)
+static unsigned long long checksum(unsigned char *data, size_t size)
+{
+    unsigned long long h, v;
+    size_t i;
+
+    h = 0x9E3779B97F4A7C15ull;
+    for(i = 0; i < size; i += 8)
+    {
+        v = 0;
+        memcpy(&v, data + i, (size - i < 8) ? size - i : 8);
+        h = (h ^ v) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    return h ^ size;
+}
+
+// ritorna i primi 8 caratteri della parola come intero, il cui ordine coincide con quello di strcmp sui prefissi
+static unsigned long long prefixKey(char *w)
+{
+    unsigned long long key;
+    int i;
+
+    key = 0;
+    for(i = 0; i < 8; i++)
+    {
+        key = (key << 8) | (unsigned char) w[i];
+        if(w[i] == '\0')
+        {
+            key <<= 8 * (7 - i);    // completo con zeri come se la parola terminasse con più terminatori
+            break;
+        }
+    }
+    return key;
+}
+
+// salva in v[] i nodi dell'albero in ordine lessicografico e ritorna il loro numero
+static int collectNodes(NODO *root, NODO **v)
+{
+    NODO *n;
+    int i;
+
+    i = 0;
+    for(n = nodeStep(root, root, RIGHT); n != root; n = nodeStep(root, n, RIGHT))
+        v[i++] = n;
+    return i;
+}
+
+// salva in post[] la posizione lessicografica dei nodi del sottoalbero radicato in n nell'ordine di visita posticipata
+// (base è la posizione lessicografica del primo nodo del sottoalbero)
+static void collectPostorder(NODO *root, NODO *n, int base, int *post, int *k)
+{
+    if(n == root) return;   // caso base
+
+    collectPostorder(root, n->children[LEFT], base, post, k);
+    collectPostorder(root, n->children[RIGHT], base + n->children[LEFT]->nodes + 1, post, k);
+    post[(*k)++] = base + n->children[LEFT]->nodes;
+}
+
+// riempie le posizioni di Eytzinger a partire da k visitando in ordine l'albero implicito (figli di k in 2k e 2k+1)
+static int fillEytzinger(FROZEN *z, int i, int k)
+{
+    if(k > z->n) return i;
+
+    i = fillEytzinger(z, i, 2*k);
+    z->keys[k] = prefixKey(frozenWord(z, i));
+    z->rank[k] = i++;
+    return fillEytzinger(z, i, 2*k + 1);
+}
+
+// ritorna la posizione lessicografica della parola nell'istantanea (-1 se assente)
+static int frozenFind(FROZEN *z, char *w)
+{
+    unsigned long long key;
+    int k;
+
+    // scendo a destra (2k+1) finché la parola in k è minore di quella cercata, senza fermarmi in caso di uguaglianza:
+    // il confronto completo serve solo quando i prefissi coincidono; i pronipoti di k (8k..8k+7) stanno in una sola
+    // linea di cache, quindi la richiedo in anticipo di tre livelli
+    key = prefixKey(w);
+    k = 1;
+    while(k <= z->n)
+    {
+        prefetch(z->keys + 8*k);
+        k = 2*k + (z->keys[k] < key || (z->keys[k] == key && strcmp(frozenWord(z, z->rank[k]), w) < 0));
+    }
+
+    // l'ultima volta che sono sceso a sinistra ero sul primo elemento non minore di w: elimino le discese a destra
+    // successive (bit a 1 in fondo a k) e quella a sinistra
+    while(k & 1)
+        k >>= 1;
+    k >>= 1;
+
+    if(k == 0 || z->keys[k] != key || strcmp(frozenWord(z, z->rank[k]), w) != 0) return -1;
+    return z->rank[k];
+}
+
+// crea l'immagine dell'istantanea del dizionario in z, allineata a 64 byte perché i gruppi di 8 chiavi richiesti in
+// anticipo occupino una sola linea di cache; ritorna 1 in caso di errori di allocazione
+static int frozenImage(FROZEN *z, NODO *dictionary)
+{
+    SnapshotHeader *h;
+    unsigned char *image;
+    NODO **v;
+    size_t strings, pos, len;
+    int i, k, n;
+
+    n = countWord(dictionary);
+    v = (NODO **) malloc((n + 1) * sizeof(NODO *));
+    if(v == NULL) return 1;
+    collectNodes(dictionary, v);
+
+    // calcolo lo spazio per tutte le stringhe, in modo da allocare l'immagine con una sola malloc
+    strings = 0;
+    for(i = 0; i < n; i++)
+        strings += strlen(v[i]->word) + strlen(v[i]->def) + 2;
+
+    z->memory = calloc(frozenSize(n, strings) + 64, 1);
+    if(z->memory == NULL)
+    {
+        free(v);
+        return 1;
+    }
+    image = (unsigned char *) (((size_t) z->memory + 63) & ~(size_t) 63);
+    h = (SnapshotHeader *) image;
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic));
+    h->version = SNAPSHOT_VERSION;
+    h->endian = SNAPSHOT_ENDIAN;
+    h->n = n;
+    h->strings = strings;
+    frozenAttach(z, image);
+
+    // copio parole e definizioni in ordine lessicografico, poi dispongo le chiavi secondo Eytzinger e salvo l'ordine in
+    // cui searchAdvance visita l'albero, da cui dipende la scelta fra parole alla stessa distanza
+    pos = 0;
+    for(i = 0; i < n; i++)
+    {
+        len = strlen(v[i]->word) + 1;
+        z->words[i] = pos;
+        memcpy(z->strings + pos, v[i]->word, len);
+        pos += len;
+
+        len = strlen(v[i]->def) + 1;
+        z->defs[i] = pos;
+        memcpy(z->strings + pos, v[i]->def, len);
+        pos += len;
+    }
+    fillEytzinger(z, 0, 1);
+    k = 0;
+    collectPostorder(dictionary, head(dictionary), 0, z->post, &k);
+    h->checksum = checksum(image + sizeof(SnapshotHeader), frozenSize(n, strings) - sizeof(SnapshotHeader));
+
+    free(v);
+    return 0;
+}
+
+// controlla che l'immagine di size byte sia un'istantanea valida scritta su una macchina con lo stesso ordine dei byte,
+// compresi i limiti di tutte le posizioni, così le ricerche non possono uscire dall'immagine; ritorna 1 se non lo è
+static int frozenCheck(unsigned char *image, size_t size)
+{
+    SnapshotHeader *h;
+    FROZEN z;
+    int i;
+
+    h = (SnapshotHeader *) image;
+    if(size < sizeof(SnapshotHeader) || memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+       h->version != SNAPSHOT_VERSION || h->endian != SNAPSHOT_ENDIAN || h->n >= INT_MAX / 2 ||
+       h->strings > size || frozenSize((size_t) h->n, (size_t) h->strings) != size ||
+       h->checksum != checksum(image + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)))
+        return 1;
+
+    frozenAttach(&z, image);
+    if(z.n > 0 && z.strings[h->strings - 1] != '\0') return 1;
+    for(i = 0; i < z.n; i++)
+        if(z.words[i] >= h->strings || z.defs[i] >= h->strings || z.rank[i + 1] < 0 || z.rank[i + 1] >= z.n ||
+           z.post[i] < 0 || z.post[i] >= z.n)
+            return 1;
+    return 0;
+}
+
+// trova le tre parole più simili visitandole nell'ordine in cui searchAdvance visita l'albero originale, quindi con
+// gli stessi risultati (le parole sono confrontate a gruppi di DL_LANES come in spellFlush)
+static void frozenSpellCheck(FROZEN *z, DLPattern *p, int *d, char **r)
+{
+    char *w, *pending[DL_LANES];
+    int i, j, m, dist[DL_LANES];
+
+    m = 0;
+    for(i = 0; i < z->n; i++)
+    {
+        w = frozenWord(z, z->post[i]);
+        if(abs((int) strlen(w) - p->len) > d[0]) continue;
+
+        pending[m++] = w;
+        if(m == DL_LANES)
+        {
+#if DL_LANES > 1
+            DL_distances(p, pending, dist);
+#else
+            dist[0] = DL_distance(p, pending[0], d[0]);
+#endif
+            for(j = 0; j < m; j++)
+                orderedInsertion(dist[j], pending[j], d, r, 3);
+            m = 0;
+        }
+    }
+    for(j = 0; j < m; j++)
+        orderedInsertion(DL_distance(p, pending[j], d[0]), pending[j], d, r, 3);
+}
+
+// scrive l'immagine dell'istantanea in un file temporaneo, lo rende persistente e solo allora lo sostituisce al file
+// name, così un errore o un'interruzione lasciano intatta l'istantanea precedente; ritorna 0 solo dopo aver reso
+// persistente anche la sostituzione, che deve precedere l'accorciamento del log; ritorna 1 in caso di errori
+static int frozenWrite(FROZEN *z, char *name)
+{
+    FILE *f;
+    char *temp;
+    size_t size;
+    int error;
+
+    temp = fileName(name, ".tmp");
+    if(temp == NULL) return 1;
+    fopen_s(&f, temp, "wb");
+    if(f == NULL)
+    {
+        free(temp);
+        return 1;
+    }
+
+    size = frozenSize(z->n, (size_t) z->header->strings);
+    error = (fwrite(z->header, 1, size, f) != size);
+    error = syncFile(f) || error;
+    error = (fclose(f) != 0) || error;
+    if(error || replaceFile(temp, name))
+    {
+        remove(temp);
+        error = 1;
+    }
+    else
+        error = syncDirectory(name);
+    free(temp);
+    return error;
+}
+
+// ricostruisce un dizionario modificabile dall'istantanea, le cui parole sono già ordinate e distinte (NULL in caso
+// di errori)
+static NODO* frozenThaw(FROZEN *z)
+{
+    NODO *dictionary;
+    NodeBatch batch = {NULL, 0, 0};
+    char *def;
+    int i, error;
+
+    dictionary = init();
+    error = (dictionary == NULL);
+    for(i = 0; !error && i < z->n; i++)
+    {
+        def = frozenDef(z, i);
+        error = batchPush(dictionary, &batch, frozenWord(z, i), def, strlen(def));
+    }
+
+    if(error)
+        free(batch.v);
+    if(error || buildBatch(dictionary, &batch) != 0)
+    {
+        destroyDictionary(dictionary);
+        return NULL;
+    }
+    return dictionary;
+}
+
+/// FUNZIONI STATICHE PER IL LOG DELLE MODIFICHE
+
+// log delle modifiche di un dizionario: ogni insertWord, cancWord e insertDef scrive un record numerato prima di
+// applicare la modifica; l'istantanea salva il numero dell'ultimo record che contiene, così alla riapertura vengono
+// rieseguiti solo i record successivi
+struct _Journal
+{
+    FILE *f;                        // log aperto in aggiunta
+    char *logName;
+    char *snapshotName;
+    size_t size;                    // byte del log, intestazione compresa
+    unsigned long long sequence;    // numero dell'ultimo record scritto
+    int pending;                    // record scritti dall'ultima volta in cui il log è stato reso persistente
+    int groupCommit;                // record dopo i quali il log viene reso persistente (0 = solo da commitDictionary)
+    int failed;                     // 1 dopo un errore di scrittura: le modifiche successive vengono rifiutate
+    // compattazione: un thread scrive l'istantanea mentre le modifiche continuano ad essere aggiunte al log
+    int compacting;                 // 1 se il thread è stato avviato e non ancora atteso
+    int done;                       // incrementato dal thread quando ha finito
+    int result;                     // 0 se il thread ha sostituito l'istantanea
+    FROZEN image;                   // istantanea scritta dal thread
+    unsigned long long compacted;   // numero dell'ultimo record contenuto nell'istantanea
+    size_t offset;                  // posizione nel log del primo record successivo
+    Thread thread;
+};
+
+// record del log letto dal file, con parola e definizione (non terminate) nel contenuto del file
+typedef struct
+{
+    int op;     // WAL_INSERT, WAL_CANCEL o WAL_DEFINE
+    char *word;
+    size_t wordLen;
+    char *def;
+    size_t defLen;
+} WalRecord;
+
+// scrive v su bytes byte a partire dal più significativo, come lo legge readNumber
+static void storeNumber(unsigned char *p, unsigned long long v, int bytes)
+{
+    for(bytes--; bytes >= 0; bytes--)
+        *p++ = (unsigned char) (v >> (bytes * BITSEQUENCE_LENGTH));
+}
+
+// legge il prossimo record: tipo, lunghezza della parola (1 byte), della definizione (4 byte, solo per WAL_DEFINE),
+// parola, definizione e somma di controllo (4 byte); ritorna 1 se il record è incompleto o danneggiato, come l'ultimo
+// di un log interrotto durante la scrittura
+static int readRecord(MappedFile *m, WalRecord *r)
+{
+    unsigned long long v;
+    size_t start;
+    int c;
+
+    start = m->pos;
+    r->op = nextByte(m);
+    if(r->op != WAL_INSERT && r->op != WAL_CANCEL && r->op != WAL_DEFINE) return 1;
+    c = nextByte(m);
+    if(c == EOF || c > MAX_WORD) return 1;
+    r->wordLen = c;
+    r->defLen = 0;
+    if(r->op == WAL_DEFINE)
+    {
+        if(readNumber(m, 4, &v) != 0) return 1;
+        r->defLen = (size_t) v;
+    }
+    if(m->size - m->pos < r->wordLen || m->size - m->pos - r->wordLen < r->defLen) return 1;
+    r->word = (char *) m->data + m->pos;
+    r->def = r->word + r->wordLen;
+    m->pos += r->wordLen + r->defLen;
+
+    if(readNumber(m, 4, &v) != 0) return 1;
+    return (v != (checksum(m->data + start, m->pos - 4 - start) & 0xFFFFFFFF));
+}
+
+// applica al dizionario il record letto dal log (la parola è già stata normalizzata da insertWord); ritorna 1 solo in
+// caso di errori di allocazione
+static int applyRecord(NODO **dictionary, WalRecord *r)
+{
+    char w[MAX_WORD + 1], *def;
+
+    memcpy(w, r->word, r->wordLen);
+    w[r->wordLen] = '\0';
+    if(r->op == WAL_INSERT)
+        insertWord(dictionary, w);
+    else if(r->op == WAL_CANCEL)
+        cancWord(dictionary, w);
+    else
+    {
+        def = (char *) malloc(r->defLen + 1);
+        if(def == NULL) return 1;
+        memcpy(def, r->def, r->defLen);
+        def[r->defLen] = '\0';
+        insertDef(*dictionary, w, def);
+        free(def);
+    }
+    return 0;
+}
+
+// scrive in temp un log con l'intestazione (numero dell'istantanea da cui parte) seguita da size byte di record e lo
+// rende persistente; ritorna 1 in caso di errori
+static int writeLog(char *temp, unsigned long long base, unsigned char *records, size_t size)
+{
+    FILE *f;
+    unsigned char header[WAL_HEADER];
+    int error;
+
+    fopen_s(&f, temp, "wb");
+    if(f == NULL) return 1;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, WAL_MAGIC, strlen(WAL_MAGIC));
+    storeNumber(header + 8, base, 8);
+    error = (fwrite(header, 1, sizeof(header), f) != sizeof(header));
+    error = (size > 0 && fwrite(records, 1, size, f) != size) || error;
+    error = syncFile(f) || error;
+    error = (fclose(f) != 0) || error;
+    if(error)
+        remove(temp);
+    return error;
+}
+
+// sostituisce il log con il file temporaneo di size byte e lo riapre in aggiunta; ritorna 1 in caso di errori (se la
+// sostituzione non riesce resta il log precedente, che rimane valido)
+static int replaceLog(Journal *j, char *temp, size_t size)
+{
+    int error;
+
+    if(j->f != NULL)
+        fclose(j->f);
+    error = replaceFile(temp, j->logName);
+    if(error)
+        remove(temp);
+    else
+    {
+        j->size = size;
+        error = syncDirectory(j->logName);
+    }
+
+    fopen_s(&j->f, j->logName, "ab");
+    return (j->f == NULL) || error;
+}
+
+// riesegue sul dizionario i record del log successivi all'istantanea numero sequence e riscrive il log con solo quei
+// record, togliendo quelli già contenuti nell'istantanea e l'eventuale ultimo record incompleto (se il log non esiste
+// ne crea uno vuoto); ritorna 1 se il log non è valido, se mancano dei record o in caso di errori
+static int replayLog(NODO **dictionary, Journal *j, unsigned long long sequence)
+{
+    MappedFile m;
+    WalRecord r;
+    unsigned long long base;
+    size_t start, end;
+    char *temp;
+    int error;
+
+    temp = fileName(j->logName, ".tmp");
+    if(temp == NULL) return 1;
+    j->sequence = sequence;
+    if(openFile(&m, j->logName) != 0)
+    {
+        error = writeLog(temp, sequence, NULL, 0) || replaceLog(j, temp, WAL_HEADER);
+        free(temp);
+        return error;
+    }
+
+    // il primo record del log ha numero base + 1, che non può superare il successivo dell'istantanea
+    m.pos = 8;
+    error = (m.size < WAL_HEADER || memcmp(m.data, WAL_MAGIC, strlen(WAL_MAGIC)) != 0 ||
+             readNumber(&m, 8, &base) != 0 || base > sequence);
+    start = end = m.pos;
+    while(!error && readRecord(&m, &r) == 0)
+    {
+        if(++base <= sequence)
+            start = m.pos;
+        else
+            error = applyRecord(dictionary, &r);
+        end = m.pos;
+    }
+
+    if(!error)
+    {
+        if(base > j->sequence)
+            j->sequence = base;
+        error = writeLog(temp, sequence, m.data + start, end - start);
+    }
+    closeFile(&m);
+    if(!error)
+        error = replaceLog(j, temp, WAL_HEADER + end - start);
+    free(temp);
+    return error;
+}
+
+// toglie dal log i record contenuti nell'istantanea scritta dalla compattazione, copiando in un nuovo log quelli
+// aggiunti nel frattempo; ritorna 1 in caso di errori (il log precedente resta valido, perché i record già contenuti
+// nell'istantanea vengono ignorati alla riapertura)
+static int trimLog(Journal *j)
+{
+    MappedFile m;
+    char *temp;
+    int error;
+
+    temp = fileName(j->logName, ".tmp");
+    if(temp == NULL) return 1;
+    if(fflush(j->f) != 0 || openFile(&m, j->logName) != 0)
+    {
+        free(temp);
+        return 1;
+    }
+
+    error = (m.size != j->size) || writeLog(temp, j->compacted, m.data + j->offset, j->size - j->offset);
+    closeFile(&m);
+    if(!error)
+        error = replaceLog(j, temp, WAL_HEADER + j->size - j->offset);
+    free(temp);
+    return error;
+}
+
+// scrive l'istantanea della compattazione (eseguita in un thread separato)
+static THREAD_FUNC compactWorker(void *arg)
+{
+    Journal *j;
+
+    j = (Journal *) arg;
+    j->result = frozenWrite(&j->image, j->snapshotName);
+    atomicIncrement(&j->done);
+    return 0;
+}
+
+// attende la fine della compattazione in corso e accorcia il log; ritorna 1 se l'istantanea non è stata scritta
+static int finishCompaction(Journal *j)
+{
+    threadJoin(j->thread);
+    j->compacting = 0;
+    free(j->image.memory);
+    if(j->result != 0) return 1;
+
+    trimLog(j);
+    return 0;
+}
+
+// aggiunge al log il record di una modifica che non può più fallire (def solo per WAL_DEFINE) e lo rende persistente
+// ogni groupCommit record, prima che la modifica venga confermata al chiamante; ritorna 1 in caso di errori, dopo i
+// quali il log non viene più scritto
+static int logRecord(NODO *root, int op, char *word, char *def)
+{
+    Journal *j;
+    unsigned char buffer[LINE_BUFFER], *r;
+    size_t wordLen, defLen, size;
+
+    j = pool(root)->log;
+    if(j == NULL) return 0;
+    if(j->failed) return 1;
+
+    // ne approfitto per chiudere la compattazione, se il thread ha finito
+    if(j->compacting && atomicRead(&j->done))
+        finishCompaction(j);
+
+    wordLen = strlen(word);
+    defLen = (op == WAL_DEFINE) ? strlen(def) : 0;
+    if(defLen > 0xFFFFFFFF) return 1;
+    size = 2 + 4 * (op == WAL_DEFINE) + wordLen + defLen + 4;
+    r = (size <= sizeof(buffer)) ? buffer : (unsigned char *) malloc(size);
+    if(r == NULL) return 1;
+
+    r[0] = (unsigned char) op;
+    r[1] = (unsigned char) wordLen;
+    size = 2;
+    if(op == WAL_DEFINE)
+    {
+        storeNumber(r + size, defLen, 4);
+        size += 4;
+    }
+    memcpy(r + size, word, wordLen);
+    size += wordLen;
+    if(defLen > 0)
+        memcpy(r + size, def, defLen);
+    size += defLen;
+    storeNumber(r + size, checksum(r, size), 4);
+    size += 4;
+
+    j->failed = (fwrite(r, 1, size, j->f) != size);
+    if(r != buffer)
+        free(r);
+    j->size += size;
+    j->sequence++;
+    if(!j->failed && j->groupCommit > 0 && ++j->pending >= j->groupCommit)
+    {
+        j->failed = syncFile(j->f);
+        j->pending = 0;
+    }
+    return j->failed;
+}
+
+// attende l'eventuale compattazione, rende persistente il log e lo chiude; ritorna 1 se gli ultimi record non sono
+// stati scritti
+static int closeLog(Journal *j)
+{
+    int error;
+
+    if(j->compacting)
+        finishCompaction(j);
+    error = syncFile(j->f) || j->failed;
+    error = (fclose(j->f) != 0) || error;
+    free(j->logName);
+    free(j->snapshotName);
+    free(j);
+    return error;
+}
+
+/// FUNZIONI STATICHE PER CODIFICA DI HUFFMAN IN PARALLELO
+
+// esegue f sugli n argomenti consecutivi di size byte in args, ognuno in un thread: il primo nel thread chiamante, così
+// come quelli per cui non è possibile crearne uno (che vengono eseguiti dopo gli altri)
+static void runThreads(ThreadFunc f, void *args, size_t size, int n)
+{
+    Thread *threads;
+    char *started;
+    int i;
+
+    threads = (Thread *) malloc(n * sizeof(Thread));
+    started = (char *) calloc(n, sizeof(char));
+    for(i = 1; i < n && threads != NULL && started != NULL; i++)
+        started[i] = threadStart(threads[i], f, (char *) args + i * size);
+
+    f(args);
+    for(i = 1; i < n; i++)
+    {
+        if(started != NULL && started[i])
+            threadJoin(threads[i]);
+        else
+            f((char *) args + i * size);
+    }
+    free(threads);
+    free(started);
+}
+
+// voci codificate da un thread: una sequenza di blocchi completi, scritti in memoria oppure direttamente sul file
+typedef struct
+{
+    NODO **nodes;       // voci della parte, in ordine
+    int n;
+    int counts[256];    // occorrenze dei caratteri nelle voci
+    HuffCode *map;
+    BitWriter *w;
+    long long *offsets; // posizioni dei blocchi, relative all'inizio della memoria se w non scrive sul file
+} HuffPart;
+
+static THREAD_FUNC countWorker(void *arg)
+{
+    HuffPart *p;
+
+    p = (HuffPart *) arg;
+    memset(p->counts, 0, sizeof(p->counts));
+    getFrequences(p->nodes, p->n, p->counts);
+    return 0;
+}
+
+// codifica le voci della parte a blocchi di HUFF_BLOCK, ognuno chiuso dal terminatore e allineato al byte, così può
+// essere decodificato da solo partendo dalla posizione salvata nell'indice
+static THREAD_FUNC encodeWorker(void *arg)
+{
+    HuffPart *p;
+    int i;
+
+    p = (HuffPart *) arg;
+    for(i = 0; i < p->n; i++)
+    {
+        if(i % HUFF_BLOCK == 0)
+            p->offsets[i / HUFF_BLOCK] = p->w->written + (long long) p->w->used;
+        putEntry(p->w, p->map, p->nodes[i]);
+        if(i % HUFF_BLOCK == HUFF_BLOCK - 1 || i == p->n - 1)
+        {
+            putCode(p->w, &p->map[TERMINATOR]);
+            alignBits(p->w);
+        }
+    }
+    flushBits(p->w);
+    return 0;
+}
+
+// blocchi consecutivi decodificati da un thread
+typedef struct
+{
+    MappedFile *file;
+    HuffTable *table;
+    size_t start;       // posizione del primo blocco
+    int blocks;
+    NODO *root;         // dizionario da cui sono presi i nodi (uno temporaneo per ogni thread)
+    NodeBatch batch;
+    int result;         // 0 se tutti i blocchi terminano con il terminatore, -1 altrimenti
+} HuffDecoder;
+
+// decodifica i blocchi della parte, raccogliendo le voci nel suo vettore
+static THREAD_FUNC decodeWorker(void *arg)
+{
+    HuffDecoder *p;
+    BitReader reader;
+    char w[MAX_WORD+2], *d;
+    size_t size;
+    int blocks, temp;
+
+    p = (HuffDecoder *) arg;
+    size = LINE_BUFFER;
+    d = (char *) malloc(size);  // la definizione non ha una lunghezza massima, quindi il buffer viene ingrandito se serve
+    p->result = -1;
+    if(d != NULL && p->root != NULL)
+    {
+        startBits(&reader, p->file, p->start);
+        p->result = 0;
+        for(blocks = p->blocks; blocks > 0 && p->result == 0; blocks--)
+        {
+            while((temp = readEntry(p->table, &reader, w, &d, &size)) == 1)
+                if(batchAdd(p->root, &p->batch, w, strlen(w), d, strlen(d)) != 0)
+                    break;
+            if(temp != 0)
+                p->result = -1;
+            skipPadding(&reader);
+        }
+    }
+    free(d);
+    return 0;
+}
+
+/// FUNZIONI STATICHE PER L'ACCESSO CONCORRENTE
+
+// contatore dei lettori entrati da uno slot, da solo nella sua linea di cache: lettori di slot diversi non scrivono
+// mai nella stessa memoria, quindi le letture parallele non si contendono nulla
+typedef struct
+{
+    volatile int readers;
+    char padding[64 - sizeof(int)];
+} ReaderSlot;
+
+// dizionario condiviso fra più thread: i lettori si registrano nel proprio slot e procedono insieme, lo scrittore
+// segnala la sua presenza in writer e aspetta che tutti gli slot si svuotino (i lettori che arrivano nel frattempo
+// lo lasciano passare, così non può restare in attesa per sempre)
+struct _Shared
+{
+    ReaderSlot slots[SHARED_SLOTS];
+    volatile int writer;    // 1 mentre uno scrittore possiede il dizionario o aspetta di possederlo
+    NODO *dictionary;
+    void *memory;           // blocco allocato, di cui la struttura occupa la parte allineata a 64 byte
+};
+
+// sceglie lo slot del thread chiamante in base alla pagina del suo stack, diversa per ogni thread
+static int readerSlot(void)
+{
+    unsigned int page;
+    int local;
+
+    page = (unsigned int) ((size_t) &local >> 12);
+    return (int) ((page * 2654435761u) >> 16) % SHARED_SLOTS;
+}
+
+// registra un lettore nello slot k, aspettando se c'è uno scrittore
+static void readLock(SHARED *s, int k)
+{
+    while(1)
+    {
+        // l'incremento atomico è una barriera completa, perciò lo scrittore vede il lettore oppure il lettore vede lui
+        atomicIncrement(&s->slots[k].readers);
+        if(!s->writer) return;
+
+        atomicDecrement(&s->slots[k].readers);
+        while(s->writer)
+            threadYield();
+    }
+}
+
+static void readUnlock(SHARED *s, int k)
+{
+    atomicDecrement(&s->slots[k].readers);
+}
+
+// acquisisce il lucchetto, cedendo il processore finché è occupato
+static void spinLock(volatile int *lock)
+{
+    while(!atomicCompareSwap(lock, 0, 1))
+        threadYield();
+}
+
+static void spinUnlock(volatile int *lock)
+{
+    atomicDecrement(lock);
+}
+
+// acquisisce il dizionario in modo esclusivo, aspettando gli altri scrittori e poi i lettori già entrati
+static void writeLock(SHARED *s)
+{
+    int i;
+
+    spinLock(&s->writer);
+    for(i = 0; i < SHARED_SLOTS; i++)
+        while(s->slots[i].readers != 0)
+            threadYield();
+}
+
+static void writeUnlock(SHARED *s)
+{
+    spinUnlock(&s->writer);
+}
+
+// ritorna 1 se searchAdvance ricostruirebbe le liste delle parole per lunghezza, cosa che un lettore non può fare
+static int lengthPending(NODO *root)
+{
+    return (!pool(root)->lengths.valid && pool(root)->spell.v == NULL &&
+            !(pool(root)->spellThreads > 1 && countWord(root) >= SPELL_MIN_WORDS));
+}
+
+// ritorna una copia allocata della stringa (NULL se s è NULL o in caso di errori)
+static char* copyString(char *s)
+{
+    char *c;
+    size_t len;
+
+    if(s == NULL) return NULL;
+    len = strlen(s) + 1;
+    c = (char *) malloc(len);
+    if(c != NULL)
+        memcpy(c, s, len);
+    return c;
+}
+
+// dizionario diviso per intervalli di parole in shard indipendenti, ognuno condiviso con il proprio lucchetto, così
+// modifiche di shard diversi procedono in parallelo
+struct _Sharded
+{
+    int n;
+    SHARED **shards;
+    char (*splitters)[MAX_WORD + 1];    // lo shard i contiene le parole w con splitters[i-1] <= w < splitters[i]
+};
+
+// ritorna lo shard a cui appartiene la parola
+static int shardOf(SHARDED *z, char *w)
+{
+    int lo, hi, mid;
+
+    // cerco il primo separatore maggiore della parola (lo shard n-1 non ha separatore finale)
+    lo = 0;
+    hi = z->n - 1;
+    while(lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if(strcmp(w, z->splitters[mid]) < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+// registra il lettore in tutti gli shard, in ordine, così le operazioni globali vedono uno stato coerente
+static void readLockAll(SHARDED *z, int k)
+{
+    int i;
+
+    for(i = 0; i < z->n; i++)
+        readLock(z->shards[i], k);
+}
+
+static void readUnlockAll(SHARDED *z, int k)
+{
+    int i;
+
+    for(i = 0; i < z->n; i++)
+        readUnlock(z->shards[i], k);
+}
+
+/// FUNZIONI STATICHE PER IL DIZIONARIO PERSISTENTE
+
+// definizione condivisa dalle copie di un nodo in versioni diverse
+typedef struct
+{
+    int refs;
+    char text[1];   // allocata della lunghezza della definizione
+} DefText;
+
+// nodo di un left-leaning red-black tree persistente: i nodi raggiungibili da una versione pubblicata non cambiano
+// più, una modifica copia solo quelli del cammino che tocca. Non c'è il padre, che impedirebbe di condividere i
+// sottoalberi fra versioni, e ogni nodo conta i riferimenti da altri nodi e da versioni: quando arrivano a zero viene
+// liberato insieme ai figli che non sono condivisi con altri
+typedef struct _PNode
+{
+    struct _PNode *children[2];
+    DefText *def;               // NULL per la definizione predefinita
+    unsigned long long stamp;   // modifica in cui il nodo è stato creato, che può cambiarlo senza copiarlo
+    int refs;
+    int nodes;                  // numero di nodi del sottoalbero radicato nel nodo
+    int color;
+    char word[MAX_WORD + 1];
+} PNode;
+
+// versione del dizionario, valida finché non viene rilasciata da tutti quelli che la usano
+struct _Version
+{
+    PNode *root;
+    int refs;
+};
+
+// dizionario persistente: le modifiche sono eseguite una alla volta e pubblicano ognuna una nuova versione corrente
+struct _Versioned
+{
+    VERSION *current;
+    volatile int writer;        // lucchetto delle modifiche
+    volatile int publish;       // lucchetto per leggere o sostituire current
+    unsigned long long stamp;   // numero dell'ultima modifica
+    PNode **reserve;            // nodi allocati prima di ogni modifica, così non può fallire a metà
+    int reserved;
+    int reserveSize;
+};
+
+#define pnodes(n) (((n) == NULL) ? 0 : (n)->nodes)
+#define pred(n) ((n) != NULL && (n)->color == RED)
+
+// rilascia un riferimento alla definizione
+static void defRelease(DefText *d)
+{
+    if(d != NULL && atomicDecrement(&d->refs) == 1)
+        free(d);
+}
+
+// rilascia un riferimento al nodo, liberandolo con i suoi figli quando non ne restano altri
+static void pnodeRelease(PNode *n)
+{
+    if(n == NULL || atomicDecrement(&n->refs) != 1) return;
+
+    pnodeRelease(n->children[LEFT]);
+    pnodeRelease(n->children[RIGHT]);
+    defRelease(n->def);
+    free(n);
+}
+
+static void versionRelease(VERSION *v)
+{
+    if(atomicDecrement(&v->refs) != 1) return;
+
+    pnodeRelease(v->root);
+    free(v);
+}
+
+// ritorna un nodo modificabile al posto di n, di cui consuma il riferimento: n stesso se è stato creato dalla modifica
+// in corso, altrimenti una sua copia presa dalla riserva, che condivide figli e definizione
+static PNode* pnodeOwn(VERSIONED *z, PNode *n)
+{
+    PNode *c;
+
+    if(n->stamp == z->stamp) return n;
+
+    c = z->reserve[--z->reserved];
+    memcpy(c, n, sizeof(PNode));
+    c->stamp = z->stamp;
+    c->refs = 1;
+    if(c->children[LEFT] != NULL)
+        atomicIncrement(&c->children[LEFT]->refs);
+    if(c->children[RIGHT] != NULL)
+        atomicIncrement(&c->children[RIGHT]->refs);
+    if(c->def != NULL)
+        atomicIncrement(&c->def->refs);
+    pnodeRelease(n);
+    return c;
+}
+
+// rotazione del nodo modificabile h verso il lato side (LEFT porta su il figlio destro)
+static PNode* protate(VERSIONED *z, PNode *h, int side)
+{
+    PNode *x;
+
+    x = pnodeOwn(z, h->children[!side]);
+    h->children[!side] = x->children[side];
+    x->children[side] = h;
+    x->color = h->color;
+    h->color = RED;
+    x->nodes = h->nodes;
+    h->nodes = pnodes(h->children[LEFT]) + pnodes(h->children[RIGHT]) + 1;
+    return x;
+}
+
+// inverte i colori del nodo modificabile h e dei suoi figli, che diventano modificabili
+static void pflip(VERSIONED *z, PNode *h)
+{
+    int i;
+
+    h->color = !h->color;
+    for(i = LEFT; i <= RIGHT; i++)
+    {
+        h->children[i] = pnodeOwn(z, h->children[i]);
+        h->children[i]->color = !h->children[i]->color;
+    }
+}
+
+// ripristina le proprietà del left-leaning red-black tree nel nodo modificabile h risalendo
+static PNode* pbalance(VERSIONED *z, PNode *h)
+{
+    if(pred(h->children[RIGHT]) && !pred(h->children[LEFT]))
+        h = protate(z, h, LEFT);
+    if(pred(h->children[LEFT]) && pred(h->children[LEFT]->children[LEFT]))
+        h = protate(z, h, RIGHT);
+    if(pred(h->children[LEFT]) && pred(h->children[RIGHT]))
+        pflip(z, h);
+    h->nodes = pnodes(h->children[LEFT]) + pnodes(h->children[RIGHT]) + 1;
+    return h;
+}
+
+// inserisce la parola (assente) nel sottoalbero h, di cui consuma il riferimento, e ritorna la nuova radice
+static PNode* pinsert(VERSIONED *z, PNode *h, char *w)
+{
+    int side;
+
+    if(h == NULL)
+    {
+        h = z->reserve[--z->reserved];
+        memset(h, 0, sizeof(PNode));
+        strcpy_s(h->word, MAX_WORD + 1, w);
+        h->stamp = z->stamp;
+        h->refs = 1;
+        h->nodes = 1;
+        h->color = RED;
+        return h;
+    }
+
+    h = pnodeOwn(z, h);
+    side = (strcmp(w, h->word) > 0);
+    h->children[side] = pinsert(z, h->children[side], w);
+    return pbalance(z, h);
+}
+
+// sostituisce la definizione della parola (presente) nel sottoalbero h
+static PNode* pdefine(VERSIONED *z, PNode *h, char *w, DefText *def)
+{
+    int c;
+
+    h = pnodeOwn(z, h);
+    c = strcmp(w, h->word);
+    if(c == 0)
+    {
+        defRelease(h->def);
+        h->def = def;
+    }
+    else
+        h->children[c > 0] = pdefine(z, h->children[c > 0], w, def);
+    return h;
+}
+
+// porta un nodo rosso nel figlio sinistro (side = LEFT) o destro di h prima di scendervi a cancellare
+static PNode* pmoveRed(VERSIONED *z, PNode *h, int side)
+{
+    pflip(z, h);
+    if(side == LEFT && pred(h->children[RIGHT]->children[LEFT]))
+    {
+        h->children[RIGHT] = protate(z, h->children[RIGHT], RIGHT);
+        h = protate(z, h, LEFT);
+        pflip(z, h);
+    }
+    else if(side == RIGHT && pred(h->children[LEFT]->children[LEFT]))
+    {
+        h = protate(z, h, RIGHT);
+        pflip(z, h);
+    }
+    return h;
+}
+
+// cancella il minimo del sottoalbero h e ritorna la nuova radice
+static PNode* pdeleteMin(VERSIONED *z, PNode *h)
+{
+    if(h->children[LEFT] == NULL)
+    {
+        pnodeRelease(h);
+        return NULL;
+    }
+
+    h = pnodeOwn(z, h);
+    if(!pred(h->children[LEFT]) && !pred(h->children[LEFT]->children[LEFT]))
+        h = pmoveRed(z, h, LEFT);
+    h->children[LEFT] = pdeleteMin(z, h->children[LEFT]);
+    return pbalance(z, h);
+}
+
+// cancella la parola (presente) dal sottoalbero h e ritorna la nuova radice
+static PNode* pdelete(VERSIONED *z, PNode *h, char *w)
+{
+    PNode *m;
+
+    h = pnodeOwn(z, h);
+    if(strcmp(w, h->word) < 0)
+    {
+        if(!pred(h->children[LEFT]) && !pred(h->children[LEFT]->children[LEFT]))
+            h = pmoveRed(z, h, LEFT);
+        h->children[LEFT] = pdelete(z, h->children[LEFT], w);
+    }
+    else
+    {
+        if(pred(h->children[LEFT]))
+            h = protate(z, h, RIGHT);
+        if(strcmp(w, h->word) == 0 && h->children[RIGHT] == NULL)
+        {
+            pnodeRelease(h);
+            return NULL;
+        }
+        if(!pred(h->children[RIGHT]) && !pred(h->children[RIGHT]->children[LEFT]))
+            h = pmoveRed(z, h, RIGHT);
+        if(strcmp(w, h->word) == 0)
+        {
+            // prendo parola e definizione del successore, che viene cancellato al suo posto
+            for(m = h->children[RIGHT]; m->children[LEFT] != NULL; m = m->children[LEFT]);
+            strcpy_s(h->word, MAX_WORD + 1, m->word);
+            if(m->def != NULL)
+                atomicIncrement(&m->def->refs);
+            defRelease(h->def);
+            h->def = m->def;
+            h->children[RIGHT] = pdeleteMin(z, h->children[RIGHT]);
+        }
+        else
+            h->children[RIGHT] = pdelete(z, h->children[RIGHT], w);
+    }
+    return pbalance(z, h);
+}
+
+// ritorna il nodo della parola nella versione (NULL se assente)
+static PNode* pfind(PNode *n, char *w)
+{
+    int c;
+
+    while(n != NULL && (c = strcmp(w, n->word)) != 0)
+        n = n->children[c > 0];
+    return n;
+}
+
+// inizia una modifica: prende un riferimento alla radice corrente e riempie la riserva con abbastanza nodi per
+// copiare tutti quelli che la modifica può toccare (al più qualche nodo per livello, su un'altezza di al più
+// 2 log2(n + 1)); ritorna 1 in caso di errori di allocazione
+static int versionBegin(VERSIONED *z)
+{
+    PNode **r;
+    int n, need;
+
+    for(need = 2, n = pnodes(z->current->root) + 1; n > 0; n >>= 1)
+        need += 2;
+    need *= PNODE_COPIES;
+
+    if(need > z->reserveSize)
+    {
+        r = (PNode **) realloc(z->reserve, need * sizeof(PNode *));
+        if(r == NULL) return 1;
+        z->reserve = r;
+        z->reserveSize = need;
+    }
+    while(z->reserved < need)
+    {
+        z->reserve[z->reserved] = (PNode *) malloc(sizeof(PNode));
+        if(z->reserve[z->reserved] == NULL) return 1;
+        z->reserved++;
+    }
+
+    z->stamp++;
+    if(z->current->root != NULL)
+        atomicIncrement(&z->current->root->refs);
+    return 0;
+}
+
+// pubblica la versione con la radice prodotta dalla modifica al posto di quella corrente, che resta valida per chi la
+// sta ancora usando
+static void versionPublish(VERSIONED *z, VERSION *v, PNode *root)
+{
+    VERSION *old;
+
+    if(root != NULL && root->color == RED)
+        root->color = BLACK;    // la radice è stata creata o copiata dalla modifica, quindi è modificabile
+    v->root = root;
+    v->refs = 1;
+
+    spinLock(&z->publish);
+    old = z->current;
+    z->current = v;
+    spinUnlock(&z->publish);
+    versionRelease(old);
+}
+
+// stampa su file delle parole del sottoalbero n in ordine lessicografico
+static void pinorderSave(PNode *n, FILE *f)
+{
+    if(n == NULL) return;   // caso base
+
+    pinorderSave(n->children[LEFT], f);
+    fprintf(f, "\"%s\" : [%s]\n", n->word, (n->def == NULL) ? nullDef : n->def->text);
+    pinorderSave(n->children[RIGHT], f);
+}
+
+// aggiunge al vettore le parole del sottoalbero n in ordine lessicografico, ritorna 1 in caso di errori di allocazione
+static int pinorderBatch(NODO *root, NodeBatch *b, PNode *n)
+{
+    char *def;
+
+    if(n == NULL) return 0; // caso base
+
+    def = (n->def == NULL) ? nullDef : n->def->text;
+    return pinorderBatch(root, b, n->children[LEFT]) || batchPush(root, b, n->word, def, strlen(def)) ||
+           pinorderBatch(root, b, n->children[RIGHT]);
+}
+
+// salva in r[] le tre parole più simili visitando la versione in ordine (le parole sono confrontate a gruppi di
+// DL_LANES come nelle altre ricerche avanzate)
+static void versionSpellCheck(PNode *root, DLPattern *p, int *d, char **r)
+{
+    PNode *stack[2 * (sizeof(int) * CHAR_BIT + 1)], *n;
+    char *pending[DL_LANES];
+    int i, j, m, dist[DL_LANES];
+
+    i = 0;
+    m = 0;
+    n = root;
+    while(n != NULL || i > 0)
+    {
+        for(; n != NULL; n = n->children[LEFT])
+            stack[i++] = n;
+        n = stack[--i];
+
+        if(abs((int) strlen(n->word) - p->len) <= d[0])
+        {
+            pending[m++] = n->word;
+            if(m == DL_LANES)
+            {
+#if DL_LANES > 1
+                DL_distances(p, pending, dist);
+#else
+                dist[0] = DL_distance(p, pending[0], d[0]);
+#endif
+                for(j = 0; j < m; j++)
+                    orderedInsertion(dist[j], pending[j], d, r, 3);
+                m = 0;
+            }
+        }
+        n = n->children[RIGHT];
+    }
+    for(j = 0; j < m; j++)
+        orderedInsertion(DL_distance(p, pending[j], d[0]), pending[j], d, r, 3);
+}
+
+/// FUNZIONI DI LIBRERIA
+
+NODO* createFromFile(char* nameFile)
+{
+    MappedFile f;
+    NODO *dictionary;
+    NodeBatch batch = {NULL, 0, 0};
+    int error;
+
+    if(openFile(&f, nameFile) != 0) return NULL;   // apro il file e controllo che esista
+
+    // inizializzo un nuovo RBT, raccolgo le parole del testo e poi costruisco l'albero in blocco
+    dictionary = init();
+    error = (dictionary == NULL || batchText(dictionary, &batch, f.data, f.size) != 0);
+
+    closeFile(&f);
+    if(error)
+        free(batch.v);
+    if(error || buildBatch(dictionary, &batch) != 0)
+    {
+        destroyDictionary(dictionary);
+        return NULL;
+    }
+    return dictionary;
+}
+
+void printDictionary(NODO* dictionary)
+{
+    ExportBuffer e;
+
+    exportStart(&e, stdout);
+    exportEntries(&e, dictionary);
+    exportEnd(&e);
+}
+
+int countWord(NODO* dictionary)
+{
+    return head(dictionary)->nodes; // il nodo alla radice contiene il numero di nodi salvati in tutta la struttura dati
+}
+
+int insertWord(NODO** dictionary, char* word)
+{
+    NODO *newNode, *father;
+    char w[MAX_WORD + 1]; // nuova stringa perché non posso cambiare il valore di una stringa costante
+
+    // se la parola è troppo lunga o troppo corta non la inserisco
+    if(normalizeWord(word, strlen(word), w) < MIN_WORD) return 1;
+
+    // inserisco un nuovo nodo con definizione predefinita "(null)" (se la parola non è già presente)
+    newNode = insertNode(*dictionary, w, "(null)");
+    if(newNode == NULL) return 1;
+
+    // se il dizionario ha un log scrivo il record solo ora che il nodo è stato allocato; se la scrittura non riesce
+    // stacco il nuovo nodo, che è ancora una foglia, e annullo gli incrementi fatti sui suoi avi
+    if(logRecord(*dictionary, WAL_INSERT, w, NULL) != 0)
+    {
+        father = newNode->father;
+        father->children[father->children[RIGHT] == newNode] = *dictionary;
+        undoCount(*dictionary, father);
+        textFree(&pool(*dictionary)->words, newNode->word);
+        defFree(*dictionary, newNode->def);
+        nodeFree(*dictionary, newNode);
+        return 1;
+    }
+
+    // se tutto è andato a buon fine ripristino le proprietà dei RBT e aggiorno l'indice hash se è attivo
+    distributeRed(*dictionary, newNode);
+    pool(*dictionary)->lengths.valid = 0;
+    if(pool(*dictionary)->index.table != NULL)
+        hashInsert(&pool(*dictionary)->index, newNode);
+
+    // anche l'indice metrico, che in mancanza di memoria viene disattivato
+    if(pool(*dictionary)->spell.v != NULL && bkInsert(&pool(*dictionary)->spell, newNode) != 0)
+        bkDestroy(&pool(*dictionary)->spell);
+    return 0;
+}
+
+int cancWord(NODO** dictionary, char* word)
+{
+    NODO* node;
+
+    // cerco il nodo nella struttura dati
+    node = findNode(*dictionary, word);
+    if(node == NULL || logRecord(*dictionary, WAL_CANCEL, node->word, NULL) != 0) return 1;
+
+    // lo tolgo dagli indici attivi
+    if(pool(*dictionary)->index.table != NULL)
+        hashRemove(&pool(*dictionary)->index, node);
+    if(pool(*dictionary)->spell.v != NULL)
+        bkRemove(&pool(*dictionary)->spell, node);
+
+    // rimuovo il nodo e ripristino le proprietà dei RBT se il nodo eliminato non era rosso (!= NULL)
+    node = deleteNode(*dictionary, node);
+    if(node != NULL)
+        distributeDoubleBlack(*dictionary, node);
+    pool(*dictionary)->lengths.valid = 0;
+
+    // quando le parole cancellate sono più della metà dell'indice metrico lo ricostruisco con quelle rimaste
+    if(pool(*dictionary)->spell.v != NULL && 2 * pool(*dictionary)->spell.dead > pool(*dictionary)->spell.n)
+    {
+        bkDestroy(&pool(*dictionary)->spell);
+        enableSpellIndex(*dictionary);
+    }
+    return 0;
+}
+
+char* getWordAt(NODO* dictionary,int index)
+{
+    if(index < 0 || index >= countWord(dictionary)) return NULL;    // controllo che i sia un valore ammissibile
+
+    return nodeAt(dictionary, index)->word;   // se lo è ritorno la parola all'i-esimo posto
+}
+
+int insertDef(NODO* dictionary, char* word, char* def)
+{
+    NODO *n;
+
+    // cerco il nodo
+    n = findNode(dictionary, word);
+    if(n == NULL) return 1;
+
+    // se esiste copio la nuova definizione e, dopo averla scritta nel log, libero la precedente
+    def = defAlloc(dictionary, def, strlen(def));
+    if(def == NULL) return 1;
+    if(logRecord(dictionary, WAL_DEFINE, n->word, def) != 0)
+    {
+        defFree(dictionary, def);
+        return 1;
+    }
+    defFree(dictionary, n->def);
+    n->def = def;
+    return 0;
+}
+
+char* cursorSeek(CURSOR* cursor, NODO* dictionary, char* word)
+{
+    cursor->dictionary = dictionary;
+    nodeRank(dictionary, word, &cursor->node);
+    return cursorWord(cursor);
+}
+
+char* cursorSeekAt(CURSOR* cursor, NODO* dictionary, int index)
+{
+    cursor->dictionary = dictionary;
+    if(index < 0 || index >= countWord(dictionary))
+        cursor->node = dictionary; // fuori dal dizionario
+    else
+        cursor->node = nodeAt(dictionary, index);
+    return cursorWord(cursor);
+}
+
+char* cursorNext(CURSOR* cursor)
+{
+    cursor->node = nodeStep(cursor->dictionary, cursor->node, RIGHT);
+    return cursorWord(cursor);
+}
+
+char* cursorPrev(CURSOR* cursor)
+{
+    cursor->node = nodeStep(cursor->dictionary, cursor->node, LEFT);
+    return cursorWord(cursor);
+}
+
+char* cursorWord(CURSOR* cursor)
+{
+    return (cursor->node != cursor->dictionary) ? cursor->node->word : NULL;
+}
+
+char* cursorDef(CURSOR* cursor)
+{
+    return (cursor->node != cursor->dictionary) ? cursor->node->def : NULL;
+}
+
+int rankOf(NODO* dictionary, char* word)
+{
+    NODO *first;
+
+    return nodeRank(dictionary, word, &first);
+}
+
+int countRange(NODO* dictionary, char* lo, char* hi)
+{
+    NODO *first;
+
+    if(strcmp(lo, hi) >= 0) return 0;
+    return nodeRank(dictionary, hi, &first) - nodeRank(dictionary, lo, &first);
+}
+
+int prefixScan(NODO* dictionary, char* prefix, ScanCallback callback, void* arg, int limit)
+{
+    NODO *node;
+    size_t len;
+    int k;
+
+    // scendo fino alla prima parola non minore del prefisso, poi proseguo in ordine finché le parole lo contengono
+    len = strlen(prefix);
+    nodeRank(dictionary, prefix, &node);
+    for(k = 0; node != dictionary && k != limit && strncmp(node->word, prefix, len) == 0; k++)
+    {
+        callback(node->word, node->def, arg);
+        node = nodeStep(dictionary, node, RIGHT);
+    }
+    return k;
+}
+
+char* searchDef(NODO* dictionary, char* word)
+{
+    NODO *n;
+
+    n = findNode(dictionary, word); // cerco il nodo
+    if(n == NULL) return NULL;
+
+    return n->def;  // se esiste ritorno la sua definizione
+}
+
+int saveDictionary(NODO* dictionary, char* fileOutput)
+{
+	FILE *f;
+    ExportBuffer e;
+	
+	fopen_s(&f, fileOutput, "w");
+    if(f == NULL) return -1;
+
+    exportStart(&e, f);
+    exportEntries(&e, dictionary);
+    if(exportEnd(&e) != 0)
+    {
+        fclose(f);
+        return -1;
+    }
+    return (fclose(f) != 0) ? -1 : 0;
+}
+
+NODO* importDictionary(char *fileInput)
+{
+    MappedFile f;
+    NODO *dictionary;
+    NodeBatch batch = {NULL, 0, 0};
+    char *line, *end, *eol, *w, *d, *def, *close, *c;
+    int error;
+
+    if(openFile(&f, fileInput) != 0) return NULL;
+
+    // inizializzo un nuovo RBT e raccolgo i valori letti finché non arrivo al termine del file, poi costruisco l'albero
+    // in blocco (un file scritto da saveDictionary è già ordinato, perciò non viene nemmeno riordinato); le righe sono
+    // analizzate direttamente nel contenuto del file, quindi parola e definizione sono individuate senza copiarle
+    dictionary = init();
+    error = (dictionary == NULL);
+    end = (char *) f.data + f.size;
+    for(line = (char *) f.data; !error && line < end; line = eol + (eol < end))
+    {
+        // la riga finisce al primo '\n' (escluso anche l'eventuale '\r' che lo precede) o alla fine del file
+        eol = (char *) memchr(line, '\n', end - line);
+        if(eol == NULL)
+            eol = end;
+        c = (eol > line && eol[-1] == '\r') ? eol - 1 : eol;
+
+        // la "word" è la prima sequenza di caratteri diversi dagli spazi
+        for(w = line; w < c && isspace((unsigned char) *w); w++);
+        if(w == c) continue;
+        for(d = w; d < c && !isspace((unsigned char) *d); d++);
+
+        // dopo la parola salto " : [", poi la "def" continua fino a ']' (può essere più di una parola) o a fine riga
+        def = (c - d > 4) ? d + 4 : c;
+        close = (char *) memchr(def, ']', c - def);
+        if(close == NULL)
+            close = c;
+
+        error = batchAdd(dictionary, &batch, w, d - w, def, close - def);
+    }
+
+    closeFile(&f);
+    if(error)
+        free(batch.v);
+    if(error || buildBatch(dictionary, &batch) != 0)
+    {
+        destroyDictionary(dictionary);
+        return NULL;
+    }
+    return dictionary;
+}
+
+int destroyDictionary(NODO* dictionary)
+{
+    NodeChunk *chunk, *next;
+    int error;
+
+    if(dictionary == NULL) return 0;
+    error = (pool(dictionary)->log != NULL && closeLog(pool(dictionary)->log) != 0);
+
+    // tutti i nodi e le stringhe stanno nei blocchi dei pool, quindi basta liberare i blocchi e il pool stesso
+    for(chunk = pool(dictionary)->chunks; chunk != NULL; chunk = next)
+    {
+        next = chunk->next;
+        free(chunk);
+    }
+    textDestroy(&pool(dictionary)->words);
+    textDestroy(&pool(dictionary)->defs);
+    hashDestroy(&pool(dictionary)->index);
+    bkDestroy(&pool(dictionary)->spell);
+    free(pool(dictionary)->lengths.v);
+    free(pool(dictionary));
+    return error;
+}
+
+int searchAdvance(NODO* dictionary, char* word, char** primoRis, char** secondoRis, char** terzoRis)
+{
+    // inizialmente le distanze sono settate al valore massimo
+    int i, distances[3] = {MAX_WORD + 1, MAX_WORD + 1, MAX_WORD + 1};
+    char *results[3];
+    CandidateList candidates;
+    SpellState state;
+    DLPattern pattern;
+
+    if(strlen(word) > MAX_WORD) return -1;  // la matrice delle distanze non può contenere parole più lunghe
+
+    for(i=0; i<3; i++)
+    {
+        results[i] = (char *) calloc(MAX_WORD + 1, sizeof(char));
+        if(results[i] == NULL) return -1;
+    }
+
+    DL_prepare(&pattern, word);
+    state.pattern = &pattern;
+    state.d = distances;
+    state.r = results;
+    state.c = NULL;
+    state.n = 0;
+    state.error = 0;
+
+    // con l'indice metrico confronto solo le parole che non sono escluse dalla disuguaglianza triangolare
+    if(pool(dictionary)->spell.v != NULL)
+    {
+        if(bkSearch(&pool(dictionary)->spell, word, &pattern, &candidates) != 0)
+        {
+            for(i=0; i<3; i++)
+                free(results[i]);
+            return -1;
+        }
+        replayCandidates(dictionary, &candidates, distances, results);
+        free(candidates.v);
+    }
+    // senza indice, se il dizionario è abbastanza grande divido la visita fra più thread
+    else if(pool(dictionary)->spellThreads > 1 && countWord(dictionary) >= SPELL_MIN_WORDS)
+    {
+        if(parallelSpellCheck(dictionary, head(dictionary), &pattern, distances, results,
+                              pool(dictionary)->spellThreads) != 0)
+        {
+            for(i=0; i<3; i++)
+                free(results[i]);
+            return -1;
+        }
+    }
+    // altrimenti leggo solo le parole di lunghezza abbastanza vicina, riconsiderando poi i candidati nell'ordine di
+    // spellCheck (se non c'è memoria per le liste visito l'intero albero)
+    else if(lengthBuild(dictionary) == 0)
+    {
+        candidateInit(&candidates);
+        state.c = &candidates;
+        lengthSpellCheck(&pool(dictionary)->lengths, &state);
+        spellFlush(&state);
+        if(!state.error)
+            replayCandidates(dictionary, &candidates, distances, results);
+        free(candidates.v);
+        if(state.error)
+        {
+            for(i=0; i<3; i++)
+                free(results[i]);
+            return -1;
+        }
+    }
+    else
+    {
+        spellCheck(dictionary, head(dictionary), &state);
+        spellFlush(&state);
+    }
+
+    // inserisco nei parametri i puntatori alle parole trovate e ritorno true se la parola è presente nel dizionario
+    *primoRis = results[2];
+    *secondoRis = results[1];
+    *terzoRis = results[0];
+    return (distances[2] == 0); // se distances[2] == 0 allora la parola è presente nel dizionario, altrimenti non lo è
+}
+
+int compressHuffman(NODO* dictionary, char* fileOutput)
+{
+    return compressHuffmanParallel(dictionary, fileOutput, 1);
+}
+
+int compressHuffmanParallel(NODO* dictionary, char* fileOutput, int threads)
+{
+    FILE *f;
+    HuffNode *frequencies[ALPHABET], *tree;
+    HuffCode map[256];
+    HuffPart *parts;
+    BitWriter *w, *pw;
+    int counts[256];
+    NODO **nodes;
+    unsigned char lengths[ALPHABET];
+    long long *offsets, position;
+    char *c;
+    int i, j, n, blocks, nParts, first, last, offset, dim, error;
+
+    fopen_s(&f, fileOutput, "wb");
+    if(f == NULL) return -1;
+
+    // le voci sono codificate in ordine a blocchi di HUFF_BLOCK, divisi fra threads parti di blocchi consecutivi
+    n = countWord(dictionary);
+    blocks = (n + HUFF_BLOCK - 1) / HUFF_BLOCK;
+    nParts = minimum(threads, blocks);
+    if(nParts < 1) nParts = 1;
+    w = (BitWriter *) malloc(sizeof(BitWriter));
+    nodes = (NODO **) malloc((n + 1) * sizeof(NODO *));
+    offsets = (long long *) malloc((blocks + 1) * sizeof(long long));
+    parts = (HuffPart *) calloc(nParts, sizeof(HuffPart));
+    if(w == NULL || nodes == NULL || offsets == NULL || parts == NULL)
+    {
+        free(w);
+        free(nodes);
+        free(offsets);
+        free(parts);
+        fclose(f);
+        return -1;
+    }
+    collectNodes(dictionary, nodes);
+    for(i = 0; i < nParts; i++)
+    {
+        first = (int) ((long long) blocks * i / nParts);
+        last = (int) ((long long) blocks * (i + 1) / nParts);
+        parts[i].nodes = nodes + first * HUFF_BLOCK;
+        parts[i].n = minimum(last * HUFF_BLOCK, n) - first * HUFF_BLOCK;
+        parts[i].map = map;
+        parts[i].offsets = offsets + first;
+    }
+
+    // ogni parte conta le occorrenze dei propri caratteri, poi alloco un nodo per ogni carattere presente e per quelli
+    // speciali che serviranno sicuramente (le [] intorno alle definizioni e il terminatore di ogni blocco)
+    runThreads(countWorker, parts, sizeof(HuffPart), nParts);
+    memset(counts, 0, sizeof(counts));
+    for(i = 0; i < nParts; i++)
+        for(j = 0; j < 256; j++)
+            counts[j] += parts[i].counts[j];
+    counts[TERMINATOR] += blocks;
+    offset = 0;
+    error = 0;
+    for(i=0; i<ALPHABET && !error; i++)
+    {
+        frequencies[i] = NULL;
+        if(counts[i] > 0 || i == '[' || i == ']')
+        {
+            frequencies[i - offset] = huffAlloc(i, counts[i]);
+            if(frequencies[i - offset] == NULL)
+            {
+                for(j = 0; j < i - offset; j++)
+                    free(frequencies[j]);
+                error = 1;
+            }
+        }
+        else
+            offset++;
+    }
+
+    // aggiorno la dimensione dell'alfabeto e creo un heap con le lettere presenti (Build-Heap), poi dall'albero ricavo
+    // solo le lunghezze dei codici, da cui ottengo i codici canonici (le lettere assenti non producono bit)
+    memset(lengths, 0, sizeof(lengths));
+    memset(map, 0, sizeof(map));
+    if(!error)
+    {
+        dim = ALPHABET - offset;
+        for(i = dim/2 - 1; i>=0; i--)
+            heapify(frequencies, dim, i);
+        tree = createHuffmanEncTree(frequencies, dim);
+        error = (tree == NULL);
+        if(!error)
+            codeLengths(tree, 0, lengths);
+        huffDealloc(tree);
+        error = error || canonicalCodes(lengths, map) != 0;
+    }
+
+    // il file inizia con il byte di versione seguito dalle lunghezze di tutti i byte, così anche le definizioni con
+    // caratteri oltre i primi 128 vengono codificate per intero
+    startWriter(w, f);
+    putNumber(w, HUFF_WIDE, 1);
+    for(i=0; i<ALPHABET; i++)
+        putNumber(w, lengths[i], 1);
+    alignBits(w);
+
+    // con una sola parte i blocchi sono scritti direttamente sul file, altrimenti ogni thread li scrive in memoria e le
+    // parti vengono poi copiate nel file una dopo l'altra, spostando le posizioni dei blocchi di conseguenza
+    if(nParts == 1)
+        parts[0].w = w;
+    else
+        for(i = 0; i < nParts && !error; i++)
+        {
+            parts[i].w = (BitWriter *) malloc(sizeof(BitWriter));
+            if(parts[i].w == NULL)
+                error = 1;
+            else
+                startWriter(parts[i].w, NULL);
+        }
+    if(!error)
+        runThreads(encodeWorker, parts, sizeof(HuffPart), nParts);
+    if(nParts > 1)
+    {
+        flushBits(w);
+        for(i = 0; i < nParts && parts[i].w != NULL; i++)
+        {
+            pw = parts[i].w;
+            error = error || pw->error;
+            for(j = 0; j < (parts[i].n + HUFF_BLOCK - 1) / HUFF_BLOCK; j++)
+                parts[i].offsets[j] += w->written;
+            if(!error && fwrite(pw->memory, 1, (size_t) pw->written, f) != (size_t) pw->written)
+                error = 1;
+            w->written += pw->written;
+            free(pw->memory);
+            free(pw);
+        }
+    }
+
+    // in fondo l'indice con posizione e prima parola di ogni blocco, poi la posizione dell'indice e il numero di blocchi
+    position = w->written + (long long) w->used;
+    for(i = 0; i < blocks && !error; i++)
+    {
+        putNumber(w, (unsigned long long) offsets[i], 8);
+        putNumber(w, strlen(nodes[i * HUFF_BLOCK]->word), 1);
+        for(c = nodes[i * HUFF_BLOCK]->word; *c != '\0'; c++)
+            putNumber(w, (unsigned char) *c, 1);
+    }
+    putNumber(w, (unsigned long long) position, 8);
+    putNumber(w, (unsigned long long) blocks, 4);
+    alignBits(w);
+    flushBits(w);
+
+    error = error || w->error;
+    free(nodes);
+    free(offsets);
+    free(parts);
+    free(w);
+    if(fclose(f) != 0 || error) return -1;
+    return 0;
+}
+
+int decompressHuffman(char *fileInput, NODO** dictionary)
+{
+    return decompressHuffmanParallel(fileInput, dictionary, 1);
+}
+
+int decompressHuffmanParallel(char *fileInput, NODO** dictionary, int threads)
+{
+    MappedFile f;
+    HuffTable table = {NULL, 0, 0};
+    HuffIndex index = {NULL, NULL, 0};
+    HuffDecoder *parts;
+    NodeBatch batch = {NULL, 0, 0};
+    NODO **v;
+    size_t start;
+    int version, blocks, nParts, first, last, i, result;
+
+    if(openFile(&f, fileInput) != 0) return -1;
+
+    // dall'intestazione creo le tabelle di decodifica; i blocchi dei file a blocchi sono divisi fra threads parti di
+    // blocchi consecutivi, mentre i file delle versioni precedenti sono un unico blocco subito dopo l'intestazione
+    version = readHeader(&f, &table);
+    start = f.pos;
+    blocks = 1;
+    nParts = 1;
+    if(version == HUFF_FRAMED)
+    {
+        if(readIndex(&f, &index) != 0)
+            version = -1;
+        blocks = index.n;
+        nParts = minimum(threads, blocks);
+        if(nParts < 1) nParts = 1;
+    }
+
+    *dictionary = init();
+    parts = (HuffDecoder *) calloc(nParts, sizeof(HuffDecoder));
+    if(*dictionary == NULL || parts == NULL || version < 0)
+    {
+        closeFile(&f);
+        free(index.offsets);
+        free(index.keys);
+        free(table.v);
+        free(parts);
+        return -1;
+    }
+
+    // con più parti ognuna prende i nodi da un dizionario temporaneo, i cui blocchi di memoria passano poi a quello finale
+    for(i = 0; i < nParts; i++)
+    {
+        first = (int) ((long long) blocks * i / nParts);
+        last = (int) ((long long) blocks * (i + 1) / nParts);
+        parts[i].file = &f;
+        parts[i].table = &table;
+        parts[i].start = (version == HUFF_FRAMED && last > first) ? (size_t) index.offsets[first] : start;
+        parts[i].blocks = last - first;
+        parts[i].root = (nParts == 1) ? *dictionary : init();
+    }
+    runThreads(decodeWorker, parts, sizeof(HuffDecoder), nParts);
+
+    // ogni blocco termina con il terminatore, se non lo incontro per qualche motivo la decodifica non è andata a buon
+    // fine; i vettori delle parti, già in ordine, vengono uniti in quello da cui costruisco il RBT
+    result = 0;
+    if(nParts == 1)
+    {
+        result = parts[0].result;
+        batch = parts[0].batch;
+    }
+    else
+        for(i = 0; i < nParts; i++)
+        {
+            if(parts[i].root == NULL)
+            {
+                result = -1;
+                continue;
+            }
+            if(parts[i].result != 0)
+                result = -1;
+            poolMerge(*dictionary, parts[i].root);
+
+            v = (NODO **) realloc(batch.v, (batch.n + parts[i].batch.n + 1) * sizeof(NODO *));
+            if(v == NULL)
+                result = -1;
+            else
+            {
+                if(parts[i].batch.n > 0)
+                    memcpy(v + batch.n, parts[i].batch.v, parts[i].batch.n * sizeof(NODO *));
+                batch.v = v;
+                batch.n += parts[i].batch.n;
+                batch.size = batch.n + 1;
+            }
+            free(parts[i].batch.v);
+        }
+
+    // costruisco in blocco il RBT con le voci decodificate (anche se parziali in caso di errore)
+    closeFile(&f);
+    free(index.offsets);
+    free(index.keys);
+    free(table.v);
+    free(parts);
+    if(buildBatch(*dictionary, &batch) != 0)
+        result = -1;
+    return result;
+}
+
+char* searchCompressed(char *fileInput, char* word)
+{
+    MappedFile f;
+    HuffTable table = {NULL, 0, 0};
+    HuffIndex index = {NULL, NULL, 0};
+    BitReader reader;
+    char w[MAX_WORD+2], *d, *def;
+    size_t size, start;
+    int version, low, high, mid, cmp;
+
+    if(openFile(&f, fileInput) != 0) return NULL;
+
+    version = readHeader(&f, &table);
+    start = f.pos;
+    size = LINE_BUFFER;
+    d = (char *) malloc(size);
+    def = NULL;
+    cmp = 1;
+
+    if(version == HUFF_FRAMED && d != NULL && readIndex(&f, &index) == 0)
+    {
+        // cerco l'ultimo blocco la cui prima parola non segue quella cercata: solo lì può trovarsi la parola
+        low = 0;
+        high = index.n - 1;
+        while(low <= high)
+        {
+            mid = (low + high) / 2;
+            if(strcmp(index.keys[mid], word) <= 0)
+                low = mid + 1;
+            else
+                high = mid - 1;
+        }
+
+        // le voci del blocco sono in ordine, quindi mi fermo alla prima che non precede la parola cercata
+        if(high >= 0)
+        {
+            startBits(&reader, &f, (size_t) index.offsets[high]);
+            while(readEntry(&table, &reader, w, &d, &size) == 1 && (cmp = strcmp(w, word)) < 0);
+        }
+    }
+    else if(version > 0 && version != HUFF_FRAMED && d != NULL)
+    {
+        // i file delle versioni precedenti sono un unico blocco, senza alcun ordine: li leggo tutti
+        startBits(&reader, &f, start);
+        while(readEntry(&table, &reader, w, &d, &size) == 1 && (cmp = strcmp(w, word)) != 0);
+    }
+
+    if(cmp == 0)
+    {
+        def = (char *) malloc(strlen(d) + 1);
+        if(def != NULL)
+            strcpy_s(def, strlen(d) + 1, d);
+    }
+
+    closeFile(&f);
+    free(index.offsets);
+    free(index.keys);
+    free(table.v);
+    free(d);
+    return def;
+}
+
+FROZEN* freezeDictionary(NODO* dictionary)
+{
+    FROZEN *z;
+
+    z = (FROZEN *) malloc(sizeof(FROZEN));
+    if(z == NULL) return NULL;
+    if(frozenImage(z, dictionary) != 0)
+    {
+        free(z);
+        return NULL;
+    }
+    return z;
+}
+
+char* frozenSearchDef(FROZEN* frozen, char* word)
+{
+    int i;
+
+    i = frozenFind(frozen, word);   // cerco la posizione della parola
+    if(i < 0) return NULL;
+
+    return frozenDef(frozen, i);    // se esiste ritorno la sua definizione
+}
+
+char* frozenGetWordAt(FROZEN* frozen, int index)
+{
+    if(index < 0 || index >= frozen->n) return NULL;    // controllo che i sia un valore ammissibile
+
+    return frozenWord(frozen, index);
+}
+
+int frozenCountWord(FROZEN* frozen)
+{
+    return frozen->n;
+}
+
+int frozenSearchAdvance(FROZEN* frozen, char* word, char** primoRis, char** secondoRis, char** terzoRis)
+{
+    int i, distances[3] = {MAX_WORD + 1, MAX_WORD + 1, MAX_WORD + 1};
+    char *results[3];
+    DLPattern pattern;
+
+    if(strlen(word) > MAX_WORD) return -1;
+
+    for(i=0; i<3; i++)
+    {
+        results[i] = (char *) calloc(MAX_WORD + 1, sizeof(char));
+        if(results[i] == NULL)
+        {
+            while(--i >= 0)
+                free(results[i]);
+            return -1;
+        }
+    }
+
+    DL_prepare(&pattern, word);
+    frozenSpellCheck(frozen, &pattern, distances, results);
+
+    *primoRis = results[2];
+    *secondoRis = results[1];
+    *terzoRis = results[0];
+    return (distances[2] == 0);
+}
+
+void destroyFrozen(FROZEN* frozen)
+{
+    if(frozen == NULL) return;
+
+    if(frozen->memory != NULL)
+        free(frozen->memory);
+    else
+        closeFile(&frozen->file);
+    free(frozen);
+}
+
+int snapshotDictionary(NODO* dictionary, char* fileOutput)
+{
+    FROZEN z;
+    Journal *j;
+    int error;
+
+    // attendo l'eventuale compattazione in corso, che potrebbe scrivere lo stesso file temporaneo
+    j = pool(dictionary)->log;
+    if(j != NULL && j->compacting)
+        finishCompaction(j);
+
+    // l'immagine dell'istantanea viene scritta così com'è, con il numero dell'ultimo record del log se c'è
+    if(frozenImage(&z, dictionary) != 0) return -1;
+    if(j != NULL)
+        z.header->sequence = j->sequence;
+    error = frozenWrite(&z, fileOutput);
+    free(z.memory);
+    return (error) ? -1 : 0;
+}
+
+FROZEN* mapDictionary(char* fileInput)
+{
+    FROZEN *z;
+
+    z = (FROZEN *) malloc(sizeof(FROZEN));
+    if(z == NULL) return NULL;
+    if(openFile(&z->file, fileInput) != 0)
+    {
+        free(z);
+        return NULL;
+    }
+
+    // i vettori dell'istantanea sono quelli del file, che viene solo controllato
+    z->memory = NULL;
+    if(frozenCheck(z->file.data, z->file.size) != 0)
+    {
+        destroyFrozen(z);
+        return NULL;
+    }
+    frozenAttach(z, z->file.data);
+    return z;
+}
+
+NODO* openDictionary(char* fileSnapshot, char* fileLog, int groupCommit)
+{
+    FROZEN *z;
+    NODO *dictionary;
+    Journal *j;
+    FILE *f;
+    unsigned long long sequence;
+
+    // parto dall'istantanea se esiste, altrimenti da un dizionario vuoto
+    fopen_s(&f, fileSnapshot, "rb");
+    if(f == NULL)
+    {
+        dictionary = init();
+        sequence = 0;
+    }
+    else
+    {
+        fclose(f);
+        z = mapDictionary(fileSnapshot);
+        if(z == NULL) return NULL;
+        sequence = z->header->sequence;
+        dictionary = frozenThaw(z);
+        destroyFrozen(z);
+    }
+    if(dictionary == NULL) return NULL;
+
+    j = (Journal *) calloc(1, sizeof(Journal));
+    if(j == NULL)
+    {
+        destroyDictionary(dictionary);
+        return NULL;
+    }
+    j->logName = fileName(fileLog, "");
+    j->snapshotName = fileName(fileSnapshot, "");
+    j->groupCommit = groupCommit;
+
+    // rieseguo le modifiche successive all'istantanea e solo dopo collego il log, così non vengono scritte di nuovo
+    if(j->logName == NULL || j->snapshotName == NULL || replayLog(&dictionary, j, sequence) != 0)
+    {
+        if(j->f != NULL)
+            fclose(j->f);
+        free(j->logName);
+        free(j->snapshotName);
+        free(j);
+        destroyDictionary(dictionary);
+        return NULL;
+    }
+    pool(dictionary)->log = j;
+    return dictionary;
+}
+
+int commitDictionary(NODO* dictionary)
+{
+    Journal *j;
+
+    j = pool(dictionary)->log;
+    if(j == NULL) return 0;
+    if(j->failed || syncFile(j->f) != 0)
+    {
+        j->failed = 1;
+        return 1;
+    }
+    j->pending = 0;
+    return 0;
+}
+
+int compactDictionary(NODO* dictionary)
+{
+    Journal *j;
+    int error;
+
+    j = pool(dictionary)->log;
+    if(j == NULL || j->failed) return 1;
+
+    // attendo la compattazione precedente, poi copio il dizionario in un'istantanea che contiene tutti i record scritti
+    error = (j->compacting && finishCompaction(j) != 0);
+    if(fflush(j->f) != 0 || frozenImage(&j->image, dictionary) != 0) return 1;
+    j->image.header->sequence = j->sequence;
+    j->compacted = j->sequence;
+    j->offset = j->size;
+    j->done = 0;
+
+    // l'istantanea viene scritta da un altro thread (o da questo, se non è possibile crearlo)
+    j->compacting = threadStart(j->thread, compactWorker, j);
+    if(!j->compacting)
+    {
+        compactWorker(j);
+        free(j->image.memory);
+        error = (j->result != 0) || error;
+        if(j->result == 0)
+            trimLog(j);
+    }
+    return error;
+}
+
+SHARED* shareDictionary(NODO* dictionary)
+{
+    SHARED *s;
+    void *memory;
+
+    memory = calloc(sizeof(SHARED) + 64, 1);
+    if(memory == NULL) return NULL;
+    s = (SHARED *) (((size_t) memory + 63) & ~(size_t) 63);
+    s->memory = memory;
+    s->dictionary = dictionary;
+    return s;
+}
+
+char* sharedSearchDef(SHARED* shared, char* word)
+{
+    char *def;
+    int k;
+
+    // la definizione viene copiata prima di uscire, perché uno scrittore potrebbe liberarla subito dopo
+    k = readerSlot();
+    readLock(shared, k);
+    def = copyString(searchDef(shared->dictionary, word));
+    readUnlock(shared, k);
+    return def;
+}
 
-        // ora nodo e padre sono scambiati, perciò devo cambiare le variabili temporanee che puntano ad essi
-        temp = node;
-        node = father;
-        father = temp;
-    }
+char* sharedGetWordAt(SHARED* shared, int index)
+{
+    char *w;
+    int k;
+
+    k = readerSlot();
+    readLock(shared, k);
+    w = copyString(getWordAt(shared->dictionary, index));
+    readUnlock(shared, k);
+    return w;
+}
 
-    // posso ruotare intorno al nonno in modo che il padre si sposti in cima e scambio le colorazioni del padre e del nonno
-    grandfather->color = RED;
-    father->color = BLACK;
-    rotate(grandfather, isLeftChild(father)); // ruoto a destra se il padre è figlio sinistro o viceversa
+int sharedCountWord(SHARED* shared)
+{
+    int n, k;
+
+    k = readerSlot();
+    readLock(shared, k);
+    n = countWord(shared->dictionary);
+    readUnlock(shared, k);
+    return n;
 }
 
-// rimuove un nodo dal RBT ma senza controllare che le proprietà siano preservate e ritorna un nodo adiacente al nodo rimosso
-NODO* deleteNode(NODO* node)
+void sharedPrintDictionary(SHARED* shared)
 {
-    NODO *temp, *child, *father;
-    int isRedNode;
+    int k;
 
-    // avendo trovato il nodo, dato che devo rimuoverlo, decremento il valore dei nodi di tutti i suoi avi e anche di se
-    // stesso perché potrei dover eliminare il suo successore al suo posto
-    temp = node;
-    while(strcmp(temp->word, SENTINEL) != 0)
-    {
-        temp->nodes--;
-        temp = temp->father;
-    }
+    k = readerSlot();
+    readLock(shared, k);
+    printDictionary(shared->dictionary);
+    readUnlock(shared, k);
+}
 
-    // se il nodo ha entrambi i figli lo sostituisco il suo valore con quello del suo successore e poi rimuovo il successore
-    // nel cercare il successore diminuisco di uno il campo nodes di tutti i nodi incontrati
-    if(node->nodes > 1)
+int sharedSearchAdvance(SHARED* shared, char* word, char** primoRis, char** secondoRis, char** terzoRis)
+{
+    int result, k;
+
+    // se le liste per lunghezza vanno ricostruite lo faccio in modo esclusivo; se non c'è memoria per farlo la ricerca
+    // stessa (che riproverebbe a costruirle) viene eseguita in modo esclusivo
+    k = readerSlot();
+    readLock(shared, k);
+    while(lengthPending(shared->dictionary))
     {
-        // il successore è il nodo più a sinistra del sottoalbero destro
-        temp = node->children[RIGHT];
-        while(strcmp(temp->children[LEFT]->word, SENTINEL) != 0)
+        readUnlock(shared, k);
+        writeLock(shared);
+        if(lengthPending(shared->dictionary) && lengthBuild(shared->dictionary) != 0)
         {
-            temp->nodes--;
-            temp = temp->children[LEFT];
+            result = searchAdvance(shared->dictionary, word, primoRis, secondoRis, terzoRis);
+            writeUnlock(shared);
+            return result;
         }
-
-        strcpy_s(node->word, sizeof(node->word), temp->word);    // scambio il valore del successore con quello del nodo
-        node = temp;    // una volta finito, devo eliminare il successore, quindi assegno il suo indirizzo a node
+        writeUnlock(shared);
+        readLock(shared, k);
     }
+    result = searchAdvance(shared->dictionary, word, primoRis, secondoRis, terzoRis);
+    readUnlock(shared, k);
+    return result;
+}
 
-    // collego il padre del nodo al suo eventuale unico figlio (destro o sinistro)
-    father = node->father;
-    child = node->children[strcmp(node->children[LEFT]->word, SENTINEL) == 0];
-    child->father = father;
-    father->children[!isLeftChild(node)] = child;
+int sharedInsertWord(SHARED* shared, char* word)
+{
+    int result;
 
-    // infine controllo il colore del nodo e lo dealloco: se è rosso ritorno NULL altrimenti ritorno il figlio del nodo
-    // (nel caso fosse la sentinella avrà comunque il padre del nodo eliminato come suo padre)
-    isRedNode = (node->color == RED);
-    free(node);
-    return isRedNode ? NULL : child;
+    writeLock(shared);
+    result = insertWord(&shared->dictionary, word);
+    writeUnlock(shared);
+    return result;
 }
 
-// distribuisce il doppio nero sull'albero in seguito a un'eliminazione
-static void distributeDoubleBlack(NODO *node)
+int sharedCancWord(SHARED* shared, char* word)
 {
-    NODO *father, *sibling;
+    int result;
 
-    father = node->father;
-    sibling = father->children[isLeftChild(node)];
+    writeLock(shared);
+    result = cancWord(&shared->dictionary, word);
+    writeUnlock(shared);
+    return result;
+}
 
-    // se il nodo è rosso o è alla radice (il padre è la sentinella) coloro il nodo di nero
-    if(node->color == RED || strcmp(father->word, SENTINEL) == 0)
-    {
-        node->color = BLACK;
-        return;
-    }
+int sharedInsertDef(SHARED* shared, char* word, char* def)
+{
+    int result;
 
-    // CASO 1: il fratello è rosso (quindi entrambi i figli sono neri come anche il padre)
-    // mi basta ruotare intorno al padre e al fratello scambiando i loro colori per rientrare in uno dei casi successivi
-    if(sibling->color == RED)
-    {
-        sibling->color = BLACK;
-        father->color = RED;
-        rotate(father, isLeftChild(sibling));
+    writeLock(shared);
+    result = insertDef(shared->dictionary, word, def);
+    writeUnlock(shared);
+    return result;
+}
 
-        sibling = father->children[isLeftChild(node)]; // in seguito alle rotazioni cambia il fratello del nodo
-    }
+void destroyShared(SHARED* shared)
+{
+    if(shared == NULL) return;
 
-    // CASO 2: il fratello è nero
-    // se ha entrambi i figli neri, posso colorare il fratello di rosso
-    if(sibling->children[LEFT]->color == BLACK && sibling->children[RIGHT]->color == BLACK)
-    {
-        sibling->color = RED;
+    destroyDictionary(shared->dictionary);
+    free(shared->memory);
+}
 
-        if(father->color == RED)
-            father->color = BLACK;  // nel caso in cui anche il padre fosse rosso, mi basta colorarlo di nero
-        else
-            distributeDoubleBlack(father);  // altrimenti il padre diventa il nodo con doppio nero
+SHARDED* shardDictionary(NODO* dictionary, int shards)
+{
+    SHARDED *z;
+    NODO **v, *root;
+    NodeBatch batch;
+    int i, j, n, first, last, error;
+
+    // un dizionario con log non può essere diviso senza perdere la persistenza delle modifiche
+    if(pool(dictionary)->log != NULL) return NULL;
+
+    // con meno parole che shard divido l'alfabeto per iniziali, quindi gli shard non possono essere più delle lettere
+    n = countWord(dictionary);
+    if(shards < 1)
+        shards = 1;
+    if(n < shards && shards > 'z' - 'a' + 1)
+        shards = 'z' - 'a' + 1;
+    v = (NODO **) malloc((n + 1) * sizeof(NODO *));
+    z = (SHARDED *) calloc(1, sizeof(SHARDED));
+    if(v == NULL || z == NULL)
+    {
+        free(v);
+        free(z);
+        return NULL;
     }
-    else
+    z->n = shards;
+    z->shards = (SHARED **) calloc(shards, sizeof(SHARED *));
+    z->splitters = malloc(shards * sizeof(*z->splitters));
+    error = (z->shards == NULL || z->splitters == NULL);
+
+    // i separatori dividono le parole presenti in parti uguali; se sono meno degli shard divido l'alfabeto per iniziali
+    collectNodes(dictionary, v);
+    for(i = 1; !error && i < shards; i++)
     {
-        // se padre e figlio rosso non sono allineati, ruoto intorno ad essi per fare in modo che lo siano
-        // a quel punto scambio i loro colori e imposto l'ex-figlio rosso come fratello perché è salito di un livello
-        if(sibling->children[!isLeftChild(sibling)]->color != RED)
+        if(n >= shards)
+            strcpy_s(z->splitters[i - 1], MAX_WORD + 1, v[(long long) i * n / shards]->word);
+        else
         {
-            sibling->color = RED;
-            sibling->children[isLeftChild(sibling)]->color = BLACK; // il nodo rosso è quello non allineato
-
-            // se il fratello è figlio sinistro allora il figlio rosso è figlio destro, quindi ruoto verso sinistra
-            rotate(sibling, !isLeftChild(sibling));
-            sibling = sibling->father;  // il nuovo "fratello" da esaminare è il nodo padre di quello corrente
+            z->splitters[i - 1][0] = (char) ('a' + ('z' - 'a' + 1) * i / shards);
+            z->splitters[i - 1][1] = '\0';
         }
+    }
 
-        // una volta che il figlio rosso del fratello è allineato con esso, coloro di nero il figlio,
-        // poi scambio il colore del padre e del fratello e infine ruoto intorno padre e al fratello
-        sibling->color = father->color;
-        father->color = BLACK;
-        sibling->children[!isLeftChild(sibling)]->color = BLACK;
+    // ogni shard è costruito in blocco con le copie delle sue parole, già ordinate
+    first = 0;
+    for(i = 0; !error && i < shards; i++)
+    {
+        for(last = first; last < n && (i == shards - 1 || strcmp(v[last]->word, z->splitters[i]) < 0); last++);
+        root = init();
+        batch.v = NULL;
+        batch.n = batch.size = 0;
+        error = (root == NULL);
+        for(j = first; !error && j < last; j++)
+            error = batchPush(root, &batch, v[j]->word, v[j]->def, strlen(v[j]->def));
+        if(error)
+            free(batch.v);
+
+        // ogni shard ha gli stessi indici e la stessa configurazione della ricerca avanzata del dizionario diviso
+        error = error || buildBatch(root, &batch) != 0 ||
+                (pool(dictionary)->index.table != NULL && enableHashIndex(root) != 0) ||
+                (pool(dictionary)->spell.v != NULL && enableSpellIndex(root) != 0);
+        if(!error)
+            setSearchThreads(root, pool(dictionary)->spellThreads);
+        if(error || (z->shards[i] = shareDictionary(root)) == NULL)
+        {
+            destroyDictionary(root);
+            error = 1;
+        }
+        first = last;
+    }
 
-        // se il fratello è figlio sinistro allora ruoto verso destra, altrimenti verso sinistra
-        rotate(father, isLeftChild(sibling));
+    free(v);
+    if(error)
+    {
+        destroySharded(z);
+        return NULL;
     }
+    destroyDictionary(dictionary);
+    return z;
 }
 
-// restituisce il nodo con valore cercato
-static NODO* nodeSearch(NODO *root, char *w)
+int shardedInsertWord(SHARDED* sharded, char* word)
 {
-    // se il nodo vale SENTINEL significa che non ho trovato il valore, quindi ritorno NULL
-    if(strcmp(root->word, SENTINEL) == 0) return NULL;
+    char w[MAX_WORD + 1];
 
-    // se invece trovo il nodo lo ritorno
-    if(strcmp(root->word, w) == 0) return root;
-
-    // altrimenti scendo nel sottoalbero sinistro (0 = false) o destro(1 = true) in base al valore dell'elemento cercato
-    return nodeSearch(root->children[strcmp(w, root->word) > 0], w);
+    // lo shard dipende dalla parola normalizzata, che è quella salvata
+    if(normalizeWord(word, strlen(word), w) < MIN_WORD) return 1;
+    return sharedInsertWord(sharded->shards[shardOf(sharded, w)], w);
 }
 
-// restituisce il nodo in posizione i-esima
-static NODO* nodeAt(NODO *root, int i)
+int shardedCancWord(SHARDED* sharded, char* word)
 {
-    int leftNodes, pos;
-
-    leftNodes = root->children[LEFT]->nodes; // nodi nel sottoalbero sinistro
-
-    // se i = nodi sinistri allora, dato che conto partendo da 0, questo è l'i-esimo nodo
-    if(i == leftNodes) return root;
-
-    // se i < al numero di nodi a sinistra, lo cerco nel sottoalbero sinistro
-    // altrimenti cerco nel sottoalbero destro in posizione i - nodi - 1
-    pos = i > leftNodes;
-    if(pos == RIGHT)
-        i -= (leftNodes + 1);
-
-    return nodeAt(root->children[pos], i);
+    return sharedCancWord(sharded->shards[shardOf(sharded, word)], word);
 }
 
-/// FUNZIONI STATICHE PER DIZIONARIO
-
-// stampa a video delle parole in ordine lessicografico
-static void inorderPrint(NODO* dictionary)
+int shardedInsertDef(SHARDED* sharded, char* word, char* def)
 {
-    if(strcmp(dictionary->word, SENTINEL) == 0) return; // caso base
+    return sharedInsertDef(sharded->shards[shardOf(sharded, word)], word, def);
+}
 
-    inorderPrint(dictionary->children[LEFT]);
-    printf("\"%s\" : [%s]\n", dictionary->word, dictionary->def);
-    inorderPrint(dictionary->children[RIGHT]);
+char* shardedSearchDef(SHARDED* sharded, char* word)
+{
+    return sharedSearchDef(sharded->shards[shardOf(sharded, word)], word);
 }
 
-// stampa su file delle parole in ordine lessicografico
-static void inorderSave(NODO* dictionary, FILE *f)
+int shardedCountWord(SHARDED* sharded)
 {
-    if(strcmp(dictionary->word, SENTINEL) == 0) return; // caso base
+    int i, n, k;
 
-    inorderSave(dictionary->children[LEFT], f);
-    fprintf(f, "\"%s\" : [%s]\n", dictionary->word, dictionary->def);
-    inorderSave(dictionary->children[RIGHT], f);
+    k = readerSlot();
+    readLockAll(sharded, k);
+    for(n = 0, i = 0; i < sharded->n; i++)
+        n += countWord(sharded->shards[i]->dictionary);
+    readUnlockAll(sharded, k);
+    return n;
 }
 
-// crea un nuovo nodo con la parola e la definizione indicata
-static NODO* newWord(NODO *dictionary, char *word, char *def)
+char* shardedGetWordAt(SHARDED* sharded, int index)
 {
-    NODO *newNode;
-    char w[MAX_WORD]; // nuova stringa perché non posso cambiare il valore di una stringa costante
-    int i, j;
-
-    // salvo la parola in minuscolo su w[]
-    j = 0;
-    for(i = 0; word[i] != '\0'; i++)
+    NODO *d;
+    char *w;
+    int i, k;
+
+    // sottraggo all'indice le parole degli shard precedenti finché non cade in uno di essi
+    k = readerSlot();
+    readLockAll(sharded, k);
+    w = NULL;
+    for(i = 0; index >= 0 && i < sharded->n; i++)
     {
-        // i caratteri ammissibili sono le lettere, il trattino e le parentesi tonde (nella definizione nulla)
-        if(isalpha(word[i]) || word[i] == '-' || word[i] == '(' || word[i] == ')')
+        d = sharded->shards[i]->dictionary;
+        if(index < countWord(d))
         {
-            w[j] = tolower(word[i]);
-
-            // controllo che la parola non vada in overflow
-            if(j < MAX_WORD)
-                j++;
-            else
-                return NULL;
+            w = copyString(getWordAt(d, index));
+            break;
         }
+        index -= countWord(d);
     }
-    w[j] = '\0';
+    readUnlockAll(sharded, k);
+    return w;
+}
 
-    // se la parola è troppo corta o è già presente non la inserisco
-    if(j < MIN_WORD || searchDef(dictionary, w) != NULL) return NULL;
+void shardedPrintDictionary(SHARDED* sharded)
+{
+    int i, k;
 
-    // altrimenti alloco un nuovo nodo con valore "word" e definizione "def"
-    newNode = nodeAlloc(dictionary, w, def);
-    return newNode;
+    k = readerSlot();
+    readLockAll(sharded, k);
+    for(i = 0; i < sharded->n; i++)
+        printDictionary(sharded->shards[i]->dictionary);
+    readUnlockAll(sharded, k);
 }
 
-/// FUNZIONI DI LIBRERIA
-
-NODO* createFromFile(char* nameFile)
+int shardedSaveDictionary(SHARDED* sharded, char* fileOutput)
 {
     FILE *f;
-    NODO *dictionary;
-    char w[MAX_WORD];
-
-    fopen_s(&f, nameFile, "r");   // apro il file e controllo che esista
-    if(f == NULL) return NULL;
+    ExportBuffer e;
+    int i, k, error;
 
-    // inizializzo un nuovo RBT e inserisco i valori letti finché non arrivo al termine del file
-    dictionary = init();
-    while(!feof(f))
-    {
-        fscanf_s(f, "%s", w, sizeof(w));
-        insertWord(&dictionary, w);
-    }
+    fopen_s(&f, fileOutput, "w");
+    if(f == NULL) return -1;
 
-    fclose(f);
-    return dictionary;
+    // gli shard coprono intervalli consecutivi, quindi basta salvarli uno dopo l'altro
+    k = readerSlot();
+    readLockAll(sharded, k);
+    exportStart(&e, f);
+    for(i = 0; i < sharded->n; i++)
+        exportEntries(&e, sharded->shards[i]->dictionary);
+    error = exportEnd(&e);
+    readUnlockAll(sharded, k);
+    return (fclose(f) != 0 || error) ? -1 : 0;
 }
 
-void printDictionary(NODO* dictionary)
+void destroySharded(SHARDED* sharded)
 {
-    inorderPrint(head(dictionary)); // chiamo head(dictionary) per non considerare la sentinella
+    int i;
+
+    if(sharded == NULL) return;
+
+    if(sharded->shards != NULL)
+        for(i = 0; i < sharded->n; i++)
+            destroyShared(sharded->shards[i]);
+    free(sharded->shards);
+    free(sharded->splitters);
+    free(sharded);
 }
 
-int countWord(NODO* dictionary)
+VERSIONED* versionDictionary(NODO* dictionary)
 {
-    return head(dictionary)->nodes; // il nodo alla radice contiene il numero di nodi salvati in tutta la struttura dati
+    VERSIONED *z;
+    NODO **v;
+    PNode *root, *node;
+    int i, n, error;
+
+    n = countWord(dictionary);
+    v = (NODO **) malloc((n + 1) * sizeof(NODO *));
+    z = (VERSIONED *) calloc(1, sizeof(VERSIONED));
+    if(z != NULL)
+    {
+        // la versione iniziale ha subito il riferimento di z, così destroyVersioned la libera anche da qui
+        z->current = (VERSION *) calloc(1, sizeof(VERSION));
+        if(z->current != NULL)
+            z->current->refs = 1;
+        z->reserve = (PNode **) malloc(sizeof(PNode *));
+    }
+    if(v == NULL || z == NULL || z->current == NULL || z->reserve == NULL)
+    {
+        free(v);
+        destroyVersioned(z);
+        return NULL;
+    }
+    z->reserveSize = 1;
+
+    // copio le parole in ordine come un'unica modifica, perciò tutti i nodi sono modificabili e nessuno viene copiato
+    collectNodes(dictionary, v);
+    z->stamp = 1;
+    root = NULL;
+    error = 0;
+    for(i = 0; !error && i < n; i++)
+    {
+        z->reserve[0] = (PNode *) malloc(sizeof(PNode));
+        error = (z->reserve[0] == NULL);
+        if(error) break;
+        z->reserved = 1;
+        root = pinsert(z, root, v[i]->word);
+        root->color = BLACK;
+
+        if(v[i]->def != nullDef)
+        {
+            node = pfind(root, v[i]->word);
+            node->def = (DefText *) malloc(sizeof(DefText) + strlen(v[i]->def));
+            error = (node->def == NULL);
+            if(!error)
+            {
+                node->def->refs = 1;
+                strcpy_s(node->def->text, strlen(v[i]->def) + 1, v[i]->def);
+            }
+        }
+    }
+
+    free(v);
+    z->current->root = root;
+    if(error)
+    {
+        destroyVersioned(z);
+        return NULL;
+    }
+    return z;
 }
 
-int insertWord(NODO** dictionary, char* word)
+int versionedInsertWord(VERSIONED* versioned, char* word)
 {
-    NODO *newNode;
+    VERSION *v;
+    char w[MAX_WORD + 1];
 
-    // alloco un nuovo nodo con definizione predefinita "(null)"
-    newNode = newWord(*dictionary, word, "(null)");
-    if(newNode == NULL) return 1;
+    // come insertWord salvo la parola normalizzata, se non è già presente
+    if(normalizeWord(word, strlen(word), w) < MIN_WORD) return 1;
 
-    // se tutto è andato a buon fine inserisco il nuovo nodo e ripristino le proprietà dei RBT
-    insertNode(head(*dictionary), newNode);
-    distributeRed(newNode);
+    spinLock(&versioned->writer);
+    v = (VERSION *) malloc(sizeof(VERSION));
+    if(v == NULL || pfind(versioned->current->root, w) != NULL || versionBegin(versioned) != 0)
+    {
+        spinUnlock(&versioned->writer);
+        free(v);
+        return 1;
+    }
+    versionPublish(versioned, v, pinsert(versioned, versioned->current->root, w));
+    spinUnlock(&versioned->writer);
     return 0;
 }
 
-int cancWord(NODO** dictionary, char* word)
+int versionedCancWord(VERSIONED* versioned, char* word)
 {
-    NODO* node;
+    VERSION *v;
+    PNode *root;
 
-    // cerco il nodo nella struttura dati
-    node = nodeSearch(head(*dictionary), word);
-    if(node == NULL) return 1;
+    spinLock(&versioned->writer);
+    v = (VERSION *) malloc(sizeof(VERSION));
+    root = versioned->current->root;
+    if(v == NULL || pfind(root, word) == NULL || versionBegin(versioned) != 0)
+    {
+        spinUnlock(&versioned->writer);
+        free(v);
+        return 1;
+    }
 
-    // rimuovo il nodo e ripristino le proprietà dei RBT se il nodo eliminato non era rosso (!= NULL)
-    node = deleteNode(node);
-    if(node != NULL)
-        distributeDoubleBlack(node);
+    // come nei left-leaning red-black tree la radice diventa rossa se lo sono entrambi i figli
+    root = pnodeOwn(versioned, root);
+    if(!pred(root->children[LEFT]) && !pred(root->children[RIGHT]))
+        root->color = RED;
+    versionPublish(versioned, v, pdelete(versioned, root, word));
+    spinUnlock(&versioned->writer);
     return 0;
 }
 
-char* getWordAt(NODO* dictionary,int index)
+int versionedInsertDef(VERSIONED* versioned, char* word, char* def)
 {
-    if(index < 0 || index >= countWord(dictionary)) return NULL;    // controllo che i sia un valore ammissibile
+    VERSION *v;
+    DefText *d;
+    size_t len;
+
+    len = strlen(def);
+    spinLock(&versioned->writer);
+    v = (VERSION *) malloc(sizeof(VERSION));
+    d = (DefText *) malloc(sizeof(DefText) + len);
+    if(v == NULL || d == NULL || pfind(versioned->current->root, word) == NULL || versionBegin(versioned) != 0)
+    {
+        spinUnlock(&versioned->writer);
+        free(v);
+        free(d);
+        return 1;
+    }
 
-    return nodeAt(head(dictionary), index)->word;   // se lo è ritorno la parola all'i-esimo posto
+    // la definizione predefinita non viene copiata
+    if(len == sizeof(nullDef) - 1 && memcmp(def, nullDef, len) == 0)
+    {
+        free(d);
+        d = NULL;
+    }
+    else
+    {
+        d->refs = 1;
+        memcpy(d->text, def, len + 1);
+    }
+    versionPublish(versioned, v, pdefine(versioned, versioned->current->root, word, d));
+    spinUnlock(&versioned->writer);
+    return 0;
 }
 
-int insertDef(NODO* dictionary, char* word, char* def)
+VERSION* acquireVersion(VERSIONED* versioned)
 {
-    NODO *n;
+    VERSION *v;
 
-    // cerco il nodo
-    n = nodeSearch(head(dictionary), word);
-    if(n == NULL) return 1;
-
-    // se esiste copio la nuova definizione
-    strcpy_s(n->def, sizeof(n->def), def);
-    return 0;
+    spinLock(&versioned->publish);
+    v = versioned->current;
+    atomicIncrement(&v->refs);
+    spinUnlock(&versioned->publish);
+    return v;
 }
 
-char* searchDef(NODO* dictionary, char* word)
+void releaseVersion(VERSION* version)
 {
-    NODO *n;
-
-    n = nodeSearch(head(dictionary), word); // cerco il nodo
-    if(n == NULL) return NULL;
+    if(version != NULL)
+        versionRelease(version);
+}
 
-    return n->def;  // se esiste ritorno la sua definizione
+int versionCountWord(VERSION* version)
+{
+    return pnodes(version->root);
 }
 
-int saveDictionary(NODO* dictionary, char* fileOutput)
+char* versionSearchDef(VERSION* version, char* word)
 {
-	FILE *f;
-	
-	fopen_s(&f, fileOutput, "w");
-    if(f == NULL) return -1;
+    PNode *n;
 
-    inorderSave(head(dictionary), f);
-    fclose(f);
-    return 0;
+    n = pfind(version->root, word);
+    if(n == NULL) return NULL;
+
+    return (n->def == NULL) ? nullDef : n->def->text;
 }
 
-NODO* importDictionary(char *fileInput)
+char* versionGetWordAt(VERSION* version, int index)
 {
-    FILE *f;
-    NODO *dictionary, *newNode;
-    char w[MAX_WORD+1], d[MAX_DEF+1], *c;
+    PNode *n;
 
-    fopen_s(&f, fileInput, "r");
-    if(f == NULL) return NULL;
+    if(index < 0 || index >= versionCountWord(version)) return NULL;
 
-    // inizializzo un nuovo RBT e inserisco i valori letti finché non arrivo al termine del file
-    dictionary = init();
-    while(!feof(f))
+    // scendo usando il numero di nodi dei sottoalberi sinistri, come nodeAt
+    n = version->root;
+    while(index != pnodes(n->children[LEFT]))
     {
-        fscanf_s(f, "%s", w, sizeof(w));         // leggo la "word"
-        fgets(d, 5, f);             // leggo " : ["
-        fgets(d, MAX_DEF + 1, f);   // leggo la "def" con ']' al termine (uso fgets perché può essere più di una parola)
-
-        // scambio ']' con il terminatore '\0' se presente
-        c = strchr(d, ']');
-        if (c != NULL)
-            *c = '\0';
-
-        // se non ci sono errori nell'allocazione inserisco il nuovo nodo e ripristino le proprietà dei RBT
-        newNode = newWord(dictionary, w, d);
-        if(newNode != NULL)
+        if(index < pnodes(n->children[LEFT]))
+            n = n->children[LEFT];
+        else
         {
-            insertNode(head(dictionary), newNode);
-            distributeRed(newNode);
+            index -= pnodes(n->children[LEFT]) + 1;
+            n = n->children[RIGHT];
         }
     }
-
-    fclose(f);
-    return dictionary;
+    return n->word;
 }
 
-int searchAdvance(NODO* dictionary, char* word, char** primoRis, char** secondoRis, char** terzoRis)
+int versionSearchAdvance(VERSION* version, char* word, char** primoRis, char** secondoRis, char** terzoRis)
 {
-    // inizialmente le distanze sono settate al valore massimo
     int i, distances[3] = {MAX_WORD + 1, MAX_WORD + 1, MAX_WORD + 1};
     char *results[3];
+    DLPattern pattern;
+
+    if(strlen(word) > MAX_WORD) return -1;
+
     for(i=0; i<3; i++)
     {
         results[i] = (char *) calloc(MAX_WORD + 1, sizeof(char));
-        if(results[i] == NULL) return -1;
+        if(results[i] == NULL)
+        {
+            while(--i >= 0)
+                free(results[i]);
+            return -1;
+        }
     }
 
-    spellCheck(head(dictionary), word, distances, results);
+    DL_prepare(&pattern, word);
+    versionSpellCheck(version->root, &pattern, distances, results);
 
-    // inserisco nei parametri i puntatori alle parole trovate e ritorno true se la parola è presente nel dizionario
     *primoRis = results[2];
     *secondoRis = results[1];
     *terzoRis = results[0];
-    return (distances[2] == 0); // se distances[2] == 0 allora la parola è presente nel dizionario, altrimenti non lo è
+    return (distances[2] == 0);
 }
 
-int compressHuffman(NODO* dictionary, char* fileOutput)
+int versionSaveDictionary(VERSION* version, char* fileOutput)
 {
     FILE *f;
-    HuffNode *frequencies[ALPHABET], *tree;
-    char c, code[ALPHABET], *map[ALPHABET];
-    int i, k, offset, dim;
 
-    fopen_s(&f, fileOutput, "wb");
+    fopen_s(&f, fileOutput, "w");
     if(f == NULL) return -1;
 
-    // inizializzo a NULL l'array di nodi perché molti di essi probabilmente non serviranno
-    for(i=0; i<ALPHABET; i++)
-        frequencies[i] = NULL;
-    frequencies['['] = huffAlloc('[', 0);                   // caratteri speciali che serviranno sicuramente
-    frequencies[']'] = huffAlloc(']', 0);
-    frequencies[TERMINATOR] = huffAlloc(TERMINATOR, 1);
-    if(frequencies[TERMINATOR] == NULL) return -1;
+    pinorderSave(version->root, f);
+    return (fclose(f) != 0) ? -1 : 0;
+}
 
-    // ottengo le frequenze e rimuovo quelle nulle (i nodi non inizializzati)
-    getFrequences(head(dictionary), frequencies);
-    offset = 0;
-    for(i=0; i<ALPHABET; i++)
+NODO* thawVersion(VERSION* version)
+{
+    NODO *dictionary;
+    NodeBatch batch = {NULL, 0, 0};
+    int error;
+
+    // le parole della versione sono già ordinate e distinte, quindi il dizionario è costruito in blocco
+    dictionary = init();
+    error = (dictionary == NULL || pinorderBatch(dictionary, &batch, version->root) != 0);
+
+    if(error)
+        free(batch.v);
+    if(error || buildBatch(dictionary, &batch) != 0)
     {
-        if(frequencies[i] != NULL)
-        {
-            frequencies[i - offset] = frequencies[i];
-            frequencies[i] = NULL;
-        }
-        else
-            offset++;
+        destroyDictionary(dictionary);
+        return NULL;
     }
-    // aggiorno la dimensione dell'alfabeto e creo un heap con le lettere presenti (Build-Heap)
-    dim = ALPHABET - offset;
-    for(i = dim/2 - 1; i>=0; i--)
-        heapify(frequencies, dim, i);
+    return dictionary;
+}
 
-    // inizializzo la mappa con i codici identificativi di ogni lettera, poi vado a riempire la mappa dopo aver creato l'albero
-    for(i=0; i<ALPHABET; i++)
-        map[i] = NULL;
-    tree = createHuffmanEncTree(frequencies, dim);
-    saveCharactersMap(map, tree, code, 0, f);
-    huffDealloc(tree);
+void destroyVersioned(VERSIONED* versioned)
+{
+    if(versioned == NULL) return;
+
+    if(versioned->current != NULL)
+        versionRelease(versioned->current);
+    while(versioned->reserved > 0)
+        free(versioned->reserve[--versioned->reserved]);
+    free(versioned->reserve);
+    free(versioned);
+}
 
-    // inserisco il divisore fra la mappa per decodificare l'albero e il resto del file
-    c = DIVIDER;
-    fwrite(&c, sizeof(char), 1, f);
+int enableHashIndex(NODO* dictionary)
+{
+    HashIndex *h;
 
-    // codifico i dati e al termine aggiungo il terminatore in modo da sapere dove si conclude la codifica
-    k = 0;
-    c = '\0';
-    encode(head(dictionary), map, &k, &c, f);
-    code[0] = TERMINATOR;
-    code[1] = '\0';
-    addSequenceofBits(code, &k, &c, map, f);
+    h = &pool(dictionary)->index;
+    if(h->table != NULL) return 0;  // l'indice è già attivo
+
+    if(hashCreate(h, countWord(dictionary)) != 0) return 1;
+    hashTree(h, dictionary, head(dictionary));
+    return 0;
+}
 
-    // al termine shifto a sinistra delle BITSEQUENCE_LENGTH - k posizioni rimanenti e stampo l'ultimo carattere
-    c <<= (BITSEQUENCE_LENGTH-k);
-    fwrite(&c, sizeof(char), 1, f);
+void disableHashIndex(NODO* dictionary)
+{
+    hashDestroy(&pool(dictionary)->index);
+}
 
-    for(i=0; i<ALPHABET; i++)
-        if(map[i] != NULL) free(frequencies[i]);
+int enableSpellIndex(NODO* dictionary)
+{
+    BKTree *t;
 
-    fclose(f);
+    t = &pool(dictionary)->spell;
+    if(t->v != NULL) return 0;  // l'indice è già attivo
+
+    if(bkTree(t, dictionary, head(dictionary)) != 0)
+    {
+        bkDestroy(t);
+        return 1;
+    }
+
+    // anche un dizionario vuoto deve avere il vettore allocato per risultare indicizzato
+    if(t->v == NULL)
+    {
+        t->v = (BKNode *) malloc(POOL_CHUNK * sizeof(BKNode));
+        if(t->v == NULL) return 1;
+        t->size = POOL_CHUNK;
+    }
     return 0;
 }
 
-int decompressHuffman(char *fileInput, NODO** dictionary)
+void disableSpellIndex(NODO* dictionary)
 {
-    FILE *f;
-    HuffNode *tree;
-    NODO *newNode;
-    char w[MAX_WORD+1], d[MAX_DEF+1], c, temp;
-    int readWord, i, k;
-
-    fopen_s(&f, fileInput, "rb");
-    if(f == NULL) return -1;
+    bkDestroy(&pool(dictionary)->spell);
+}
 
-    tree = createHuffmanDecTree(f);
-    *dictionary = init();
-    readWord = 1;
-    i = 0;
-    k = 0;
-    fread(&c, sizeof(char), 1, f); // leggo il primo carattere
+void setSearchThreads(NODO* dictionary, int threads)
+{
+    pool(dictionary)->spellThreads = (threads > 1) ? threads : 1;
+}
 
-    while(!feof(f))
+int searchAdvanceBatch(NODO* dictionary, char* words[], int n, AdvanceResult results[])
+{
+    BatchState *b;
+    BatchQuery *q;
+    int i, k;
+
+    // un'unica allocazione contiene il blocco di parole e lo stato di tutte le ricerche
+    b = (BatchState *) malloc(sizeof(BatchState) + n * sizeof(BatchQuery));
+    if(b == NULL) return -1;
+    b->queries = (BatchQuery *) (b + 1);
+    b->n = n;
+    b->count = 0;
+
+    // le parole trovate vengono scritte direttamente nei risultati, con la più simile in words[0]
+    for(i=0; i<n; i++)
     {
-        temp = decodeChar(tree, &c, &k, f);
-        if(temp == '[') // quando trovo una '[' termino la parola e mi preparo a leggere la definizione
-        {
-            readWord = 0;
-            w[i] = '\0';
-            i = 0;
-        }
-        else if(temp == ']') // quando trovo una ']' inserisco il nodo nel dizionario e mi preparo a leggere una nuova parola
-        {
-            readWord = 1;
-            d[i] = '\0';
-            i = 0;
+        q = &b->queries[i];
+        if(strlen(words[i]) > MAX_WORD)
+            q->pattern.len = -1;
+        else
+            DL_prepare(&q->pattern, words[i]);
 
-            newNode = newWord(*dictionary, w, d);
-            if(newNode != NULL)
-            {
-                insertNode(head(*dictionary), newNode);
-                distributeRed(newNode);
-            }
-        }
-        else if(temp == TERMINATOR) // quando incontro il terminatore ho finito di leggere
+        for(k=0; k<3; k++)
         {
-            fclose(f);
-            huffDealloc(tree);
-            return 0;
+            q->d[k] = MAX_WORD + 1;
+            q->r[k] = results[i].words[2 - k];
+            q->r[k][0] = '\0';
         }
-        else
-        {
-            // inserisco il carattere letto nella parola o nella definizione
-            if(readWord)
-                w[i] = temp;
-            else
-                d[i] = temp;
+    }
 
-            i++;
-        }
+    batchCheck(dictionary, head(dictionary), b);
+    batchFlush(b);
+
+    for(i=0; i<n; i++)
+    {
+        q = &b->queries[i];
+        for(k=0; k<3; k++)
+            results[i].distances[k] = q->d[2 - k];
+        results[i].found = (q->pattern.len < 0) ? -1 : (q->d[2] == 0);
     }
 
-    // se arrivo qui significa che non ho incontrato il terminatore per qualche motivo
-    fclose(f);
-    huffDealloc(tree);
-    return -1;
+    free(b);
+    return 0;
 }
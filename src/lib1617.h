@@ -1,4 +1,3 @@
-#define MAX_DEF 50
 #define MAX_WORD 20
 #define MIN_WORD 2
 
@@ -8,18 +7,58 @@
 #define LEFT 0
 #define RIGHT 1
 #define SENTINEL ""
+#define POOL_CHUNK 256 // nodi allocati insieme ad ogni chiamata a malloc
+#define TEXT_CHUNK 65536 // byte dei blocchi da cui vengono prese le stringhe corte
+#define TEXT_SMALL 256 // lunghezza massima (con terminatore) delle stringhe prese dai blocchi
+#define TEXT_CLASS 8 // le stringhe corte occupano un multiplo di TEXT_CLASS byte
+#define WORD_SEPARATOR 1 // classe dei caratteri che separano le parole nei file letti da createFromFile
+#define LINE_BUFFER 256 // dimensione iniziale dei buffer per le definizioni lette dai file compressi
+#define HASH_SIZE 1024 // posti iniziali dell'indice hash (potenza di 2)
+#define SPELL_TASKS 8 // sottoalberi in cui la ricerca avanzata parallela è divisa per ogni thread
+#define SPELL_MIN_WORDS 4096 // parole sotto le quali la ricerca avanzata non viene divisa fra più thread
+#define SPELL_BLOCK 256 // parole del dizionario confrontate insieme con tutte le parole di searchAdvanceBatch
 
 // costanti per codifica Huffman
-#define ALPHABET 128
+#define ALPHABET 256
 #define BITSEQUENCE_LENGTH 8
 #define TERMINATOR '*'
 #define DIVIDER ';'
+#define IO_BUFFER 65536 // byte del buffer di scrittura dei file compressi (e iniziali per i file letti senza mappatura)
+#define HUFF_TABLE_BITS 10 // bit decodificati con un solo accesso a ogni tabella di decodifica
+#define HUFF_VERSION 2 // primo byte dei file con le lunghezze dei codici canonici (i vecchi iniziano con '0' o '1')
+#define HUFF_MAX_CODE 63 // lunghezza massima di un codice nell'intestazione
+#define HUFF_FRAMED 3 // primo byte dei file divisi in blocchi decodificabili separatamente, con indice in fondo
+#define HUFF_WIDE 4 // primo byte dei file a blocchi con le lunghezze dei codici di tutti i byte, non solo dei primi 128
+#define HUFF_NARROW 128 // lettere di cui i file HUFF_VERSION e HUFF_FRAMED riportano le lunghezze dei codici
+#define HUFF_BLOCK 256 // voci contenute in ogni blocco dei file compressi
+#define HUFF_TRAILER 12 // byte finali dei file a blocchi: posizione dell'indice (8 byte) e numero di blocchi (4 byte)
 
-// nodo del dizionario
+// costanti per l'accesso concorrente
+#define SHARED_SLOTS 64 // contatori fra cui sono distribuiti i lettori di un dizionario condiviso
+
+// costanti per l'esportazione
+#define EXPORT_BUFFER (1 << 20) // byte del buffer in cui printDictionary e saveDictionary formattano le voci
+
+// costanti per il dizionario persistente
+#define PNODE_COPIES 8 // nodi che una modifica può copiare al più per ogni livello dell'albero
+
+// costanti per istantanee
+#define SNAPSHOT_MAGIC "RBTSNAP" // primi 8 byte (con il terminatore) dei file di snapshotDictionary
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ENDIAN 0x01020304 // scritto nell'ordine dei byte della macchina, per riconoscere i file di un'altra
+
+// costanti per il log delle modifiche
+#define WAL_MAGIC "RBTWAL" // primi 8 byte (completati con zeri) dei file di log, seguiti dal numero dell'istantanea
+#define WAL_INSERT 'I' // tipi dei record: parola inserita, cancellata o con una nuova definizione
+#define WAL_CANCEL 'C'
+#define WAL_DEFINE 'D'
+#define WAL_HEADER 16 // byte dell'intestazione dei file di log
+
+// nodo del dizionario: contiene solo i collegamenti dell'albero, le stringhe sono memorizzate a parte
 typedef struct NODO
 {
-    char word[MAX_WORD + 1]; // +1 per terminatore '\0'
-    char def[MAX_DEF + 1];
+    char *word; // al massimo MAX_WORD caratteri
+    char *def;  // lunghezza qualsiasi
     struct NODO *father;
     struct NODO *children[2]; // children[0] = figlio sinistro, children[1] = figlio destro
     int color;
@@ -34,6 +73,40 @@ typedef struct _HuffNode
     struct _HuffNode *children[2];
 } HuffNode;
 
+// istantanea di sola lettura del dizionario, ottimizzata per le ricerche
+typedef struct _Frozen FROZEN;
+
+// dizionario condiviso fra più thread, con letture concorrenti e modifiche esclusive
+typedef struct _Shared SHARED;
+
+// dizionario diviso per intervalli di parole in più parti, modificabili in parallelo
+typedef struct _Sharded SHARDED;
+
+// dizionario persistente, le cui modifiche creano nuove versioni senza cambiare quelle precedenti
+typedef struct _Versioned VERSIONED;
+
+// versione di sola lettura di un dizionario persistente
+typedef struct _Version VERSION;
+
+// posizione in un dizionario, che si sposta da una parola alla successiva o alla precedente senza ricorsione; non è
+// più valida dopo una modifica del dizionario
+typedef struct
+{
+    NODO *dictionary;
+    NODO *node; // parola corrente, la sentinella se il cursore è fuori dal dizionario
+} CURSOR;
+
+// funzione chiamata da prefixScan per ogni parola trovata, con la sua definizione e il parametro arg
+typedef void (*ScanCallback)(char* word, char* def, void* arg);
+
+// risultato della ricerca avanzata di una parola
+typedef struct
+{
+    char words[3][MAX_WORD + 1];    // le tre voci più simili, dalla più vicina
+    int distances[3];               // distanze di Damerau-Levenshtein delle tre voci
+    int found;                      // 1 se la parola è nel dizionario, 0 se non c'è, -1 se è troppo lunga
+} AdvanceResult;
+
 
 // dato il nome del file di testo da cui viene creato un primo dizionario con definizioni assenti ritorna l'indirizzo
 // della struttura dati contenente il dizionario ordinato (NULL in caso errore)
@@ -62,12 +135,42 @@ int insertDef(NODO* dictionary, char* word, char* def);
 // ritorna la definizione di "word" se presente, NULL altrimenti
 char* searchDef(NODO* dictionary, char* word);
 
+// ritorna il numero di parole minori di "word", cioè la posizione che ha (o avrebbe) nel dizionario, l'inverso di
+// getWordAt
+int rankOf(NODO* dictionary, char* word);
+
+// ritorna il numero di parole w del dizionario con lo <= w < hi
+int countRange(NODO* dictionary, char* lo, char* hi);
+
+// chiama callback in ordine lessicografico su al più limit parole (tutte se limit è negativo) che iniziano con
+// "prefix" e ritorna il numero di parole visitate
+int prefixScan(NODO* dictionary, char* prefix, ScanCallback callback, void* arg, int limit);
+
+// posiziona il cursore sulla prima parola non minore di "word" e la ritorna (NULL se non c'è)
+char* cursorSeek(CURSOR* cursor, NODO* dictionary, char* word);
+
+// posiziona il cursore sulla parola in posizione index e la ritorna (NULL se index è fuori dal dizionario)
+char* cursorSeekAt(CURSOR* cursor, NODO* dictionary, int index);
+
+// sposta il cursore sulla parola successiva o precedente e la ritorna; dopo l'ultima o prima della prima il cursore è
+// fuori dal dizionario e viene ritornato NULL, e lo spostamento seguente riparte dalla prima o dall'ultima parola
+char* cursorNext(CURSOR* cursor);
+char* cursorPrev(CURSOR* cursor);
+
+// ritornano la parola e la definizione correnti, NULL se il cursore è fuori dal dizionario
+char* cursorWord(CURSOR* cursor);
+char* cursorDef(CURSOR* cursor);
+
 // salva il dizionario su file con il formato della stampa e ritorna 0 in caso di assenza di errori, -1 altrimenti
 int saveDictionary(NODO* dictionary, char* fileOutput);
 
 // crea un dizionario leggendo da file con il formato della stampa e lo ritorna
 NODO* importDictionary(char *fileInput);
 
+// libera tutta la memoria occupata dal dizionario (che non può più essere utilizzato); se ha un log lo rende
+// persistente e lo chiude, e ritorna 1 se gli ultimi record non sono stati scritti, 0 altrimenti
+int destroyDictionary(NODO* dictionary);
+
 
 /*
 Input:
@@ -104,3 +207,186 @@ Output:
     -(-1) in caso di presenza di errori
 */
 int decompressHuffman(char *fileInput, NODO** dictionary);
+
+// ritorna la definizione di "word" leggendola dal file compresso senza ricostruire il dizionario: nei file a blocchi
+// viene decodificato solo il blocco che può contenerla. La stringa è allocata e va liberata dal chiamante
+// (NULL se la parola non è presente o in caso di errori)
+char* searchCompressed(char *fileInput, char* word);
+
+
+// crea un'istantanea di sola lettura del dizionario, indipendente dalle sue modifiche successive (NULL in caso di errore)
+FROZEN* freezeDictionary(NODO* dictionary);
+
+// ritorna la definizione di "word" nell'istantanea se presente, NULL altrimenti
+char* frozenSearchDef(FROZEN* frozen, char* word);
+
+// ritorna la i-esima parola nell'istantanea (NULL in caso di errore)
+char* frozenGetWordAt(FROZEN* frozen, int index);
+
+// ritorna il numero di parole salvato nell'istantanea
+int frozenCountWord(FROZEN* frozen);
+
+// esegue la ricerca avanzata nell'istantanea, con gli stessi risultati e valori di ritorno che searchAdvance avrebbe sul
+// dizionario da cui è stata creata (le tre stringhe sono allocate e vanno liberate dal chiamante)
+int frozenSearchAdvance(FROZEN* frozen, char* word, char** first, char** second, char** third);
+
+// libera la memoria occupata dall'istantanea (o la mappatura del file da cui è stata letta)
+void destroyFrozen(FROZEN* frozen);
+
+// salva su file l'istantanea del dizionario in formato binario, con i vettori e le stringhe collegati da posizioni
+// invece che da puntatori; ritorna 0 in caso di assenza di errori, -1 altrimenti
+int snapshotDictionary(NODO* dictionary, char* fileOutput);
+
+// mappa in memoria un file scritto da snapshotDictionary e lo usa direttamente come istantanea di sola lettura, senza
+// ricostruire il dizionario (NULL se il file non è valido o in caso di errori); va liberata con destroyFrozen
+FROZEN* mapDictionary(char* fileInput);
+
+
+// apre un dizionario persistente: parte dall'istantanea fileSnapshot (scritta da snapshotDictionary, se non esiste
+// da un dizionario vuoto) e riesegue le modifiche successive salvate nel log fileLog. Da quel momento insertWord,
+// cancWord e insertDef aggiungono al log un record per ogni modifica prima di ritornare, e il log viene reso
+// persistente su disco ogni groupCommit record (0 = solo da commitDictionary e destroyDictionary). NULL se
+// l'istantanea o il log non sono validi o in caso di errori
+NODO* openDictionary(char* fileSnapshot, char* fileLog, int groupCommit);
+
+// rende persistenti su disco i record scritti nel log e ritorna 0 in caso di assenza di errori, 1 altrimenti (dopo un
+// errore di scrittura il log non viene più usato e le modifiche vengono rifiutate)
+int commitDictionary(NODO* dictionary);
+
+// avvia in un altro thread la scrittura di una nuova istantanea del dizionario aperto con openDictionary, dopo la
+// quale il log viene accorciato; le modifiche possono continuare nel frattempo. Ritorna 1 se non può essere avviata
+// o se la compattazione precedente non è riuscita, 0 altrimenti
+int compactDictionary(NODO* dictionary);
+
+
+// crea un indice hash che rende O(1) le ricerche esatte di searchDef, insertDef e cancWord e che viene mantenuto
+// da insertWord e cancWord (i dizionari creati da createFromFile, importDictionary e decompressHuffman partono senza);
+// ritorna 0 in caso di assenza di errori, 1 altrimenti
+int enableHashIndex(NODO* dictionary);
+
+// elimina l'indice hash del dizionario (le ricerche tornano a scendere nell'albero)
+void disableHashIndex(NODO* dictionary);
+
+
+// crea un indice metrico (BK-tree) con cui searchAdvance confronta solo una piccola parte delle parole, ottenendo gli
+// stessi risultati; viene mantenuto da insertWord e cancWord. Ritorna 0 in caso di assenza di errori, 1 altrimenti
+int enableSpellIndex(NODO* dictionary);
+
+// elimina l'indice metrico del dizionario (searchAdvance torna a confrontare tutte le parole)
+void disableSpellIndex(NODO* dictionary);
+
+
+// imposta il numero di thread usati da searchAdvance sul dizionario quando non c'è l'indice metrico (1 = ricerca
+// sequenziale, il valore iniziale di ogni dizionario); un dizionario condiviso va configurato prima di shareDictionary
+void setSearchThreads(NODO* dictionary, int threads);
+
+// esegue la ricerca avanzata delle n parole in words[] visitando il dizionario una volta sola e salva i risultati in
+// results[] (allocato dal chiamante), con le stesse voci che darebbe searchAdvance; ritorna 0, oppure -1 in caso di errori
+int searchAdvanceBatch(NODO* dictionary, char* words[], int n, AdvanceResult results[]);
+
+
+// come compressHuffman e decompressHuffman (che sono sequenziali), ma con threads thread che codificano o decodificano
+// ognuno una parte dei blocchi del file; il file prodotto non dipende dal numero di thread
+int compressHuffmanParallel(NODO* dictionary, char* fileOutput, int threads);
+int decompressHuffmanParallel(char *fileInput, NODO** dictionary, int threads);
+
+
+// rende il dizionario utilizzabile da più thread insieme attraverso le funzioni shared*: le ricerche procedono in
+// parallelo senza contendersi memoria, mentre ogni modifica attende che le ricerche in corso finiscano ed è eseguita
+// da sola. Il dizionario non va più usato direttamente (NULL in caso di errore)
+SHARED* shareDictionary(NODO* dictionary);
+
+// ritorna una copia allocata della definizione di "word", da liberare dal chiamante (NULL se non è presente o in caso
+// di errori)
+char* sharedSearchDef(SHARED* shared, char* word);
+
+// ritorna una copia allocata della i-esima parola, da liberare dal chiamante (NULL in caso di errore)
+char* sharedGetWordAt(SHARED* shared, int index);
+
+// ritorna il numero di parole salvato nel dizionario condiviso
+int sharedCountWord(SHARED* shared);
+
+// stampa il dizionario condiviso
+void sharedPrintDictionary(SHARED* shared);
+
+// esegue searchAdvance sul dizionario condiviso, con gli stessi risultati e valori di ritorno
+int sharedSearchAdvance(SHARED* shared, char* word, char** first, char** second, char** third);
+
+// eseguono insertWord, cancWord e insertDef sul dizionario condiviso, con gli stessi valori di ritorno
+int sharedInsertWord(SHARED* shared, char* word);
+int sharedCancWord(SHARED* shared, char* word);
+int sharedInsertDef(SHARED* shared, char* word, char* def);
+
+// libera il dizionario condiviso e tutta la memoria che occupa (nessun thread deve starlo ancora usando)
+void destroyShared(SHARED* shared);
+
+
+// divide il dizionario in shards parti di parole consecutive, ognuna con il proprio lucchetto, così inserimenti e
+// cancellazioni di parti diverse procedono in parallelo; i separatori dividono in parti uguali le parole presenti (o
+// l'alfabeto per iniziali, se sono meno delle parti, che allora sono al più 26). Le parti hanno gli indici hash e
+// metrico attivi sul dizionario e il suo numero di thread per searchAdvance. Il dizionario viene liberato e non va più
+// usato (NULL se ha un log, che le parti non possono mantenere, o in caso di errore: in entrambi i casi resta intatto)
+SHARDED* shardDictionary(NODO* dictionary, int shards);
+
+// eseguono insertWord, cancWord e insertDef sulla parte che contiene la parola, con gli stessi valori di ritorno
+int shardedInsertWord(SHARDED* sharded, char* word);
+int shardedCancWord(SHARDED* sharded, char* word);
+int shardedInsertDef(SHARDED* sharded, char* word, char* def);
+
+// ritorna una copia allocata della definizione di "word", da liberare dal chiamante (NULL se non è presente o in caso
+// di errori)
+char* shardedSearchDef(SHARDED* sharded, char* word);
+
+// ritorna il numero di parole di tutte le parti
+int shardedCountWord(SHARDED* sharded);
+
+// ritorna una copia allocata della i-esima parola dell'intero dizionario, da liberare dal chiamante (NULL in caso di
+// errore)
+char* shardedGetWordAt(SHARDED* sharded, int index);
+
+// stampano e salvano l'intero dizionario in ordine, come printDictionary e saveDictionary
+void shardedPrintDictionary(SHARDED* sharded);
+int shardedSaveDictionary(SHARDED* sharded, char* fileOutput);
+
+// libera tutte le parti e la memoria che occupano (nessun thread deve starle ancora usando)
+void destroySharded(SHARDED* sharded);
+
+
+// crea un dizionario persistente con una copia delle parole del dizionario, che resta invariato: ogni modifica copia
+// solo i nodi del cammino che tocca e pubblica una nuova versione, mentre quelle precedenti restano leggibili senza
+// lucchetti da chi le sta usando (NULL in caso di errore)
+VERSIONED* versionDictionary(NODO* dictionary);
+
+// eseguono insertWord, cancWord e insertDef sul dizionario persistente, con gli stessi valori di ritorno
+int versionedInsertWord(VERSIONED* versioned, char* word);
+int versionedCancWord(VERSIONED* versioned, char* word);
+int versionedInsertDef(VERSIONED* versioned, char* word, char* def);
+
+// ritorna la versione corrente, che non cambia più e resta valida finché non viene rilasciata con releaseVersion
+VERSION* acquireVersion(VERSIONED* versioned);
+
+// rilascia la versione: la memoria che non è condivisa con altre versioni viene liberata
+void releaseVersion(VERSION* version);
+
+// ritorna il numero di parole della versione
+int versionCountWord(VERSION* version);
+
+// ritorna la definizione di "word" nella versione se presente, NULL altrimenti
+char* versionSearchDef(VERSION* version, char* word);
+
+// ritorna la i-esima parola della versione (NULL in caso di errore)
+char* versionGetWordAt(VERSION* version, int index);
+
+// esegue la ricerca avanzata nella versione visitando le parole in ordine lessicografico (a parità di distanza le voci
+// possono quindi essere diverse da quelle di searchAdvance); le tre stringhe vanno liberate dal chiamante
+int versionSearchAdvance(VERSION* version, char* word, char** first, char** second, char** third);
+
+// salva la versione su file con il formato della stampa e ritorna 0 in caso di assenza di errori, -1 altrimenti
+int versionSaveDictionary(VERSION* version, char* fileOutput);
+
+// crea un normale dizionario con le parole della versione, ad esempio per comprimerlo (NULL in caso di errore)
+NODO* thawVersion(VERSION* version);
+
+// rilascia la versione corrente e la memoria del dizionario persistente; le versioni acquisite restano valide fino al
+// loro rilascio
+void destroyVersioned(VERSIONED* versioned);
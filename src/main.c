@@ -44,6 +44,7 @@ int main(void) {
 	stringTemp = "eftd";
 	printf("\nRicerca Parola \"%s\" -> definizione : [%s]\n\n", stringTemp, searchDef(dictionary, stringTemp));
 	
+	destroyDictionary(dictionary);
 
 
 	system("PAUSE");